@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+ * 连接缓冲区的水位与 shard 内存预算
+ *
+ * 输入：已读进用户态、还没被 read() 取走的字节超过 input_high 时停止读这个连接
+ *      （从 epoll 摘掉 EPOLLIN），数据留在内核里，由 TCP 流控让发送方慢下来；
+ *      取走到 input_low 以下再恢复
+ * 输出：排队未发出的字节超过 output_high 时同样停止读（不再接收新请求，也就不会产生新响应），
+ *      并让 until_writable() 挂起；发到 output_low 以下再恢复
+ * shard：所有连接读入的字节（直到接收 buffer 不再被任何 Packet 引用）加上排队的输出字节
+ *      超过 shard_budget 时，新读到数据的连接暂停读取，总量回落到预算的 3/4 以下后统一恢复
+ */
+struct ConnectionLimits {
+    size_t input_high = 256 * 1024;
+    size_t input_low = 64 * 1024;
+    size_t output_high = 1024 * 1024;
+    size_t output_low = 256 * 1024;
+};
+
+struct BufferConfig {
+    // 新连接的默认水位，可用 TcpConnection::set_limits 单独调整
+    static inline ConnectionLimits connection;
+    static inline size_t shard_budget = size_t(256) << 20;
+};
+
+// 每个 shard 一份：统计连接缓冲的字节数，超预算时登记暂停的连接，回落后逐个恢复
+class ShardBufferBudget {
+private:
+    size_t used_ = 0;
+    std::vector<std::function<void()>> waiters_;
+    // 在别的 shard 上释放的接收 buffer（经 ForeignPacket 移交出去的数据）归还的字节，由本 shard 每轮收回
+    std::atomic<size_t> remote_released_{0};
+
+public:
+    // 预算对象在堆上且不释放：移交到别的 shard 的 buffer 可能在本线程退出后才释放，仍会访问它
+    static ShardBufferBudget& local() {
+        static thread_local ShardBufferBudget* budget = new ShardBufferBudget();
+        return *budget;
+    }
+
+    size_t used() const { return used_; }
+    bool exhausted() const { return used_ >= BufferConfig::shard_budget; }
+
+    void charge(size_t n) { used_ += n; }
+
+    void release(size_t n) {
+        used_ -= n;
+        if (!waiters_.empty() && used_ <= BufferConfig::shard_budget / 4 * 3) {
+            std::vector<std::function<void()>> resumed;
+            resumed.swap(waiters_);
+            for (auto& resume : resumed) resume();
+        }
+    }
+
+    // 可以来自任意线程
+    void release_remote(size_t n) { remote_released_.fetch_add(n, std::memory_order_relaxed); }
+
+    // 由 Reactor::run 每轮调用
+    void drain_remote_releases() {
+        if (remote_released_.load(std::memory_order_relaxed) == 0) return;
+        release(remote_released_.exchange(0, std::memory_order_relaxed));
+    }
+
+    // 预算回落后调用 resume
+    void wait(std::function<void()> resume) {
+        waiters_.push_back(std::move(resume));
+    }
+};
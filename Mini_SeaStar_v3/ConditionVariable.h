@@ -0,0 +1,80 @@
+#pragma once
+#include <functional>
+#include <utility>
+#include "Future.h"
+#include "WaitQueue.h"
+
+/**
+ * Shard 本地的异步条件变量
+ * wait() 返回 Future，不阻塞 Reactor；signal() 唤醒一个等待者，broadcast() 唤醒全部
+ * 结果为 true 表示被通知；为 false 表示条件变量已 broken() 或被销毁，不能再访问它
+ * 单线程语义下无需配合互斥锁
+ */
+class ConditionVariable
+{
+    bool broken_ = false;
+    WaitQueue waiters_;
+
+public:
+    ConditionVariable() = default;
+
+    ConditionVariable(const ConditionVariable&) = delete;
+    ConditionVariable& operator=(const ConditionVariable&) = delete;
+
+    Future<bool> wait() {
+        if (broken_) return Future<bool>::make_ready(false);
+        Waiter* w = new Waiter();
+        auto fut = w->promise.get_future();
+        waiters_.push_back(w);
+        return fut;
+    }
+
+    // 带条件的等待：条件已满足则直接就绪；
+    // 否则每次被通知时重新检查，不满足的继续排队（相当于自动处理虚假唤醒）
+    template<typename Pred>
+    Future<bool> wait(Pred pred) {
+        if (broken_) return Future<bool>::make_ready(false);
+        if (pred()) return Future<bool>::make_ready(true);
+
+        Waiter* w = new Waiter();
+        w->pred = std::move(pred);
+        auto fut = w->promise.get_future();
+        waiters_.push_back(w);
+        return fut;
+    }
+
+    void signal() {
+        // 跳过条件仍不满足的等待者，把它们按原顺序放回队尾
+        size_t n = waiters_.size();
+        while (n-- > 0) {
+            Waiter* w = waiters_.pop_front();
+            if (!w->pred || w->pred()) {
+                w->promise.set_value(true);
+                delete w;
+                return;
+            }
+            waiters_.push_back(w);
+        }
+    }
+
+    void broadcast() {
+        size_t n = waiters_.size();
+        while (n-- > 0) {
+            Waiter* w = waiters_.pop_front();
+            if (!w->pred || w->pred()) {
+                w->promise.set_value(true);
+                delete w;
+            } else {
+                waiters_.push_back(w);
+            }
+        }
+    }
+
+    // 以 false 唤醒所有等待者，之后的 wait() 也立即得到 false
+    void broken() {
+        broken_ = true;
+        waiters_.break_all();
+    }
+
+    bool has_waiters() const { return !waiters_.empty(); }
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <stdexcept>
 #include <functional>
+#include <optional>
 #include <type_traits>
 #include "IntrusivePtr.h"
 #include "Poolable.h"
@@ -30,6 +31,64 @@ struct State<void> : public RefCounted<State<void>>, public Poolable<State<void>
 template<typename T>
 class Future;
 
+template<typename T>
+class Promise;
+
+/**
+ * Futurize：统一 then() 中 continuation 的三种返回值
+ *   void       -> Future<void>
+ *   Future<U>  -> Future<U>（自动展开，避免 Future<Future<U>>）
+ *   U          -> Future<U>
+ */
+template<typename R>
+struct Futurize
+{
+    using value_type = R;
+
+    template<typename Func, typename P, typename... Args>
+    static void apply(Func& f, P& p, Args&&... args) {
+        p->set_value(f(std::forward<Args>(args)...));
+    }
+
+    // 前一阶段已就绪时直接调用，结果放进就绪的 Future，不经过 Promise
+    template<typename Func, typename... Args>
+    static Future<R> invoke(Func& f, Args&&... args) {
+        return Future<R>::make_ready(f(std::forward<Args>(args)...));
+    }
+};
+
+template<>
+struct Futurize<void>
+{
+    using value_type = void;
+
+    template<typename Func, typename P, typename... Args>
+    static void apply(Func& f, P& p, Args&&... args) {
+        f(std::forward<Args>(args)...);
+        p->set_value();
+    }
+
+    // Future<void> 此时还不完整，定义放在它之后
+    template<typename Func, typename... Args>
+    static Future<void> invoke(Func& f, Args&&... args);
+};
+
+template<typename U>
+struct Futurize<Future<U>>
+{
+    using value_type = U;
+
+    template<typename Func, typename P, typename... Args>
+    static void apply(Func& f, P& p, Args&&... args) {
+        f(std::forward<Args>(args)...).forward_to(std::move(p));
+    }
+
+    template<typename Func, typename... Args>
+    static Future<U> invoke(Func& f, Args&&... args) {
+        return f(std::forward<Args>(args)...);
+    }
+};
+
 /**
  * 2. Promise 的改造
  * 因为 TcpConnection 会持有 Promise 的 LocalPtr，所以 Promise 也要池化
@@ -71,7 +130,7 @@ public:
         if (state->callback) {
             // 捕获 LocalPtr，增加引用计数（无锁）
             auto bound_task = [s = state]() {
-                s->callback(s->value);
+                s->callback(std::move(s->value)); // 移出值，支持只可移动的 T
             };
             schedule_task(std::move(bound_task));
         }
@@ -85,6 +144,8 @@ template <typename T>
 class Future
 {
     LocalPtr<State<T>> state; // 替换 std::shared_ptr
+    // make_ready 和就绪路径上的 then() 产生的结果直接放在 Future 里，不分配 State
+    std::optional<T> value_;
 
 public:
     Future(LocalPtr<State<T>> s) : state(std::move(s)) {}
@@ -92,46 +153,76 @@ public:
     Future(const Future&) = delete;
     Future& operator=(const Future&) = delete;
 
-    Future(Future&& other) noexcept : state(std::move(other.state)) {}
+    Future(Future&& other) noexcept : state(std::move(other.state)), value_(std::move(other.value_)) {
+        other.value_.reset();
+    }
     Future& operator=(Future&& other) noexcept {
-        if (this != &other) state = std::move(other.state);
+        if (this != &other) {
+            state = std::move(other.state);
+            value_ = std::move(other.value_);
+            other.value_.reset();
+        }
         return *this;
     }
 
     template<typename Func>
     auto then(Func func) {
-        using U = std::invoke_result_t<Func, T>;
+        using R = std::invoke_result_t<Func, T>;
+        using U = typename Futurize<R>::value_type;
+
+        // 已就绪：内联执行，一路就绪的链条（例如 read() 命中缓冲区后接 write()）不分配任何对象
+        if (available()) {
+            return Futurize<R>::invoke(func, get());
+        }
 
         // 使用 make_local 创建下一阶段的 Promise
         auto next_promise = make_local<Promise<U>>();
         auto next_future = next_promise->get_future();
         
         auto task = [p = next_promise, f = std::move(func)](T value) mutable {
-            if constexpr(std::is_void_v<U>) {
-                f(std::move(value));
-                p->set_value();
-            } else {           
-                p->set_value(f(std::move(value)));
-            }
+            Futurize<R>::apply(f, p, std::move(value));
         };
 
-        if (!state) throw std::runtime_error("No state");
+        on_ready(std::move(task));
+        return next_future;
+    }
 
-        if (state->ready) {
-            task(std::move(state->value));
-        } else {
-            state->callback = std::move(task);
+    // 底层挂接：不创建下一阶段的 Promise，已就绪则立即内联执行
+    // 循环组合子在挂起时用它，避免每次迭代多分配一对 Promise/State
+    void on_ready(std::function<void(T)> cb) {
+        if (available()) {
+            cb(get());
+            return;
         }
+        if (!state) throw std::runtime_error("No state");
+        state->callback = std::move(cb);
+    }
 
-        return next_future;
+    // 把结果转交给另一个 Promise（用于展开 Future<Future<T>>）
+    void forward_to(LocalPtr<Promise<T>> p) {
+        on_ready([p = std::move(p)](T value) mutable {
+            p->set_value(std::move(value));
+        });
+    }
+
+    bool available() const { return value_.has_value() || (state && state->ready); }
+
+    // 取出已就绪的值，调用前必须确认 available()
+    T get() {
+        if (value_) {
+            T v = std::move(*value_);
+            value_.reset();
+            return v;
+        }
+        if (!available()) throw std::logic_error("Future not ready");
+        return std::move(state->value);
     }
     
-    // 静态辅助方法：快速创建一个已完成的 Future
+    // 静态辅助方法：快速创建一个已完成的 Future，值直接放在 Future 里
     static Future<T> make_ready(T val) {
-        auto s = make_local<State<T>>();
-        s->value = std::move(val);
-        s->ready = true;
-        return Future<T>(std::move(s));
+        Future<T> f{LocalPtr<State<T>>()};
+        f.value_.emplace(std::move(val));
+        return f;
     }
 };
 
@@ -181,50 +272,77 @@ public:
 template <>
 class Future<void> {
     LocalPtr<State<void>> state;
+    bool ready_ = false;    // make_ready 产生的 Future 不分配 State
 
 public:
     Future(LocalPtr<State<void>> s) : state(std::move(s)) {}
 
-    Future(Future&& other) noexcept : state(std::move(other.state)) {}
+    Future(Future&& other) noexcept : state(std::move(other.state)), ready_(other.ready_) {
+        other.ready_ = false;
+    }
     Future& operator=(Future&& other) noexcept {
-         if (this != &other) state = std::move(other.state);
+         if (this != &other) {
+             state = std::move(other.state);
+             ready_ = other.ready_;
+             other.ready_ = false;
+         }
          return *this;
     }
 
     template<typename Func>
     auto then(Func func) {
-        using U = std::invoke_result_t<Func>;
+        using R = std::invoke_result_t<Func>;
+        using U = typename Futurize<R>::value_type;
+
+        if (available()) {
+            return Futurize<R>::invoke(func);
+        }
 
         auto next_promise = make_local<Promise<U>>();
         auto next_future = next_promise->get_future();
 
         auto task = [p = next_promise, f = std::move(func)]() mutable {
-            if constexpr(std::is_void_v<U>) {
-                f();
-                p->set_value();
-            } else {
-                p->set_value(f());
-            }
+            Futurize<R>::apply(f, p);
         };
 
-        if (!state) throw std::runtime_error("No state");
+        on_ready(std::move(task));
+        return next_future;
+    }
 
-        if (state->ready) {
-            task();
-        } else {
-            state->callback = std::move(task);
+    void on_ready(std::function<void()> cb) {
+        if (available()) {
+            cb();
+            return;
         }
+        if (!state) throw std::runtime_error("No state");
+        state->callback = std::move(cb);
+    }
 
-        return next_future;
+    void forward_to(LocalPtr<Promise<void>> p) {
+        on_ready([p = std::move(p)]() {
+            p->set_value();
+        });
+    }
+
+    bool available() const { return ready_ || (state && state->ready); }
+
+    void get() {
+        if (!available()) throw std::logic_error("Future not ready");
     }
 
     static Future<void> make_ready() {
-        auto s = make_local<State<void>>();
-        s->ready = true;
-        return Future<void>(std::move(s));
+        Future<void> f{LocalPtr<State<void>>()};
+        f.ready_ = true;
+        return f;
     }
 };
 
+template<typename Func, typename... Args>
+inline Future<void> Futurize<void>::invoke(Func& f, Args&&... args) {
+    f(std::forward<Args>(args)...);
+    return Future<void>::make_ready();
+}
+
 // --- 最终的 get_future 实现 ---
 template<typename T>
 inline Future<T> Promise<T>::get_future() {
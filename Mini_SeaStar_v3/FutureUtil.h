@@ -0,0 +1,189 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "Future.h"
+#include "Reactor.h"
+#include "IntrusivePtr.h"
+#include "Poolable.h"
+
+/**
+ * 循环组合子：repeat / do_until / keep_doing
+ * 用来替代 "在 continuation 里递归调用自己" 的写法：
+ *   - 整个循环只分配一个迭代状态对象（池化），每轮复用
+ *   - 只要返回的 Future 已经就绪，就留在紧凑的内联 while 循环里，不经过调度器
+ *   - 只有真正挂起时才挂接 continuation，恢复后回到同一个状态对象继续
+ */
+
+enum class StopIteration { no, yes };
+
+// 连续内联执行这么多轮后主动让出一次，防止一个始终就绪的循环饿死 Reactor
+constexpr size_t kMaxInlineIterations = 256;
+
+template<typename AsyncAction>
+class RepeatState : public RefCounted<RepeatState<AsyncAction>>,
+                    public Poolable<RepeatState<AsyncAction>>
+{
+    AsyncAction action_;
+    Promise<void> promise_;
+
+public:
+    explicit RepeatState(AsyncAction action) : action_(std::move(action)) {}
+
+    Future<void> get_future() { return promise_.get_future(); }
+
+    void step() {
+        for (size_t i = 0; i < kMaxInlineIterations; ++i) {
+            Future<StopIteration> f = action_();
+
+            if (!f.available()) {
+                f.on_ready([self = LocalPtr<RepeatState>(this)](StopIteration stop) {
+                    if (stop == StopIteration::yes) {
+                        self->promise_.set_value();
+                    } else {
+                        self->step();
+                    }
+                });
+                return;
+            }
+
+            if (f.get() == StopIteration::yes) {
+                promise_.set_value();
+                return;
+            }
+        }
+
+        schedule_task([self = LocalPtr<RepeatState>(this)]() {
+            self->step();
+        });
+    }
+};
+
+// action: () -> Future<StopIteration>，返回 StopIteration::yes 时结束循环
+template<typename AsyncAction>
+Future<void> repeat(AsyncAction action) {
+    auto st = make_local<RepeatState<AsyncAction>>(std::move(action));
+    auto fut = st->get_future();
+    st->step();
+    return fut;
+}
+
+template<typename StopCondition, typename AsyncAction>
+class DoUntilState : public RefCounted<DoUntilState<StopCondition, AsyncAction>>,
+                     public Poolable<DoUntilState<StopCondition, AsyncAction>>
+{
+    StopCondition stop_cond_;
+    AsyncAction action_;
+    Promise<void> promise_;
+
+public:
+    DoUntilState(StopCondition stop_cond, AsyncAction action)
+        : stop_cond_(std::move(stop_cond)), action_(std::move(action)) {}
+
+    Future<void> get_future() { return promise_.get_future(); }
+
+    void step() {
+        for (size_t i = 0; i < kMaxInlineIterations; ++i) {
+            if (stop_cond_()) {
+                promise_.set_value();
+                return;
+            }
+
+            Future<void> f = action_();
+            if (!f.available()) {
+                f.on_ready([self = LocalPtr<DoUntilState>(this)]() {
+                    self->step();
+                });
+                return;
+            }
+        }
+
+        schedule_task([self = LocalPtr<DoUntilState>(this)]() {
+            self->step();
+        });
+    }
+};
+
+// 每轮先检查 stop_cond，为 true 则结束；否则执行 action: () -> Future<void>
+template<typename StopCondition, typename AsyncAction>
+Future<void> do_until(StopCondition stop_cond, AsyncAction action) {
+    auto st = make_local<DoUntilState<StopCondition, AsyncAction>>(
+        std::move(stop_cond), std::move(action));
+    auto fut = st->get_future();
+    st->step();
+    return fut;
+}
+
+// 永不停止的循环，返回的 Future 不会完成（目前没有异常通道可以打断它）
+template<typename AsyncAction>
+Future<void> keep_doing(AsyncAction action) {
+    return do_until([]() { return false; }, std::move(action));
+}
+
+/**
+ * 超时：with_timeout(deadline, future[, on_timeout])
+ * 目前 Future 没有异常通道，超时以值的形式返回：
+ *   Future<T>    -> Future<std::optional<T>>，超时得到 std::nullopt
+ *   Future<void> -> Future<bool>，超时得到 false
+ * 先完成的一方胜出：future 先完成则取消 Reactor 定时器；定时器先触发则调用
+ * on_timeout（用来取消底层挂起的读写，例如 TcpConnection::cancel_read），
+ * 之后 future 再完成的结果被丢弃
+ */
+template<typename T>
+using TimeoutResult = std::conditional_t<std::is_void_v<T>, bool, std::optional<T>>;
+
+template<typename T>
+struct TimeoutState : public RefCounted<TimeoutState<T>>,
+                      public Poolable<TimeoutState<T>>
+{
+    Promise<TimeoutResult<T>> promise;
+    TimerId timer = 0;
+    bool done = false;
+};
+
+template<typename T>
+Future<TimeoutResult<T>> with_timeout(TimePoint deadline, Future<T> f,
+                                      std::function<void()> on_timeout = nullptr) {
+    // 已就绪：不用启动定时器
+    if (f.available()) {
+        if constexpr (std::is_void_v<T>) {
+            return Future<bool>::make_ready(true);
+        } else {
+            return Future<TimeoutResult<T>>::make_ready(TimeoutResult<T>(f.get()));
+        }
+    }
+
+    Reactor* r = Reactor::instance();
+    auto st = make_local<TimeoutState<T>>();
+    auto fut = st->promise.get_future();
+
+    st->timer = r->run_at(deadline, [st, cb = std::move(on_timeout)]() {
+        if (st->done) return;
+        st->done = true;
+        if (cb) cb();
+        if constexpr (std::is_void_v<T>) {
+            st->promise.set_value(false);
+        } else {
+            st->promise.set_value(std::nullopt);
+        }
+    });
+
+    if constexpr (std::is_void_v<T>) {
+        f.on_ready([st, r]() {
+            if (st->done) return;
+            st->done = true;
+            r->cancel_timer(st->timer);
+            st->promise.set_value(true);
+        });
+    } else {
+        f.on_ready([st, r](T value) {
+            if (st->done) return;
+            st->done = true;
+            r->cancel_timer(st->timer);
+            st->promise.set_value(TimeoutResult<T>(std::move(value)));
+        });
+    }
+    return fut;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include "Future.h"
+#include "IntrusivePtr.h"
+
+/**
+ * Gate：追踪在途操作
+ * 每个异步操作开始时 enter()，结束时 leave()；close() 之后拒绝新的 enter()，
+ * 并返回一个 Future，在最后一个在途操作 leave() 时完成
+ * Engine::stop 依靠它在退出 Reactor 循环前等待所有在途工作收尾：
+ * 每个打开的 TcpConnection 持有一份（见 TcpConnection.h），stop 时由 Reactor::at_stop 的回调关闭它们
+ */
+class Gate
+{
+    size_t count_ = 0;
+    bool closed_ = false;
+    LocalPtr<Promise<void>> closing_;
+
+public:
+    Gate() = default;
+
+    Gate(const Gate&) = delete;
+    Gate& operator=(const Gate&) = delete;
+
+    void enter() {
+        if (closed_) throw std::runtime_error("Gate closed");
+        ++count_;
+    }
+
+    bool try_enter() {
+        if (closed_) return false;
+        ++count_;
+        return true;
+    }
+
+    void leave() {
+        if (count_ == 0) throw std::logic_error("Gate::leave without enter");
+        --count_;
+        if (count_ == 0 && closing_) {
+            auto p = std::move(closing_);
+            p->set_value();
+        }
+    }
+
+    Future<void> close() {
+        if (closed_) throw std::logic_error("Gate already closed");
+        closed_ = true;
+
+        if (count_ == 0) {
+            return Future<void>::make_ready();
+        }
+        closing_ = make_local<Promise<void>>();
+        return closing_->get_future();
+    }
+
+    bool is_closed() const { return closed_; }
+    size_t count() const { return count_; }
+
+    // RAII：构造时 enter，析构时 leave，适合捕获进 continuation
+    class Holder
+    {
+        Gate* gate_ = nullptr;
+
+    public:
+        Holder() = default;
+        explicit Holder(Gate& gate) : gate_(&gate) { gate_->enter(); }
+
+        Holder(const Holder&) = delete;
+        Holder& operator=(const Holder&) = delete;
+
+        Holder(Holder&& other) noexcept : gate_(other.gate_) { other.gate_ = nullptr; }
+        Holder& operator=(Holder&& other) noexcept {
+            if (this != &other) {
+                if (gate_) gate_->leave();
+                gate_ = other.gate_;
+                other.gate_ = nullptr;
+            }
+            return *this;
+        }
+
+        ~Holder() {
+            if (gate_) gate_->leave();
+        }
+
+        explicit operator bool() const { return gate_ != nullptr; }
+    };
+
+    Holder hold() { return Holder(*this); }
+
+    // 已经 close() 时返回空的 Holder，不抛异常
+    Holder try_hold() { return closed_ ? Holder() : Holder(*this); }
+};
@@ -0,0 +1,187 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <utility>
+#include "TcpConnection.h"
+#include "Future.h"
+#include "FutureUtil.h"
+#include "Packet.h"
+#include "Poolable.h"
+#include "IntrusivePtr.h"
+
+/**
+ * InputStream：TcpConnection 之上的成帧读取
+ * TcpConnection::read() 返回"当前缓冲的所有数据"，这里替协议层处理半帧、粘包和分隔符查找：
+ *   read_exactly(n)     恰好 n 字节（只有遇到 EOF 才会更短）
+ *   read_up_to(n)       至多 n 字节，只取第一个分片里的数据，从不复制
+ *   read_until(delim)   直到分隔符为止（不含分隔符，分隔符本身被消费掉）
+ *   consume(consumer)   把数据逐块喂给状态机，由它决定何时停止、哪些字节还回流中
+ *
+ * 返回的 Packet 直接引用 NetBuffer（零拷贝）；只有一帧跨越了两个接收缓冲区时才拷贝成连续内存
+ * 和 TcpConnection 一样通过 make_local 创建，continuation 持有引用，流在读取挂起期间保持存活
+ */
+
+// consume() 的消费者返回值：继续要数据，或者停止并把没用完的部分还给流
+struct ConsumeResult {
+    bool stop;
+    Packet unconsumed;
+
+    static ConsumeResult more() { return ConsumeResult{false, Packet()}; }
+    static ConsumeResult done(Packet unconsumed = Packet()) { return ConsumeResult{true, std::move(unconsumed)}; }
+};
+
+class InputStream : public Poolable<InputStream>, public RefCounted<InputStream>
+{
+private:
+    LocalPtr<TcpConnection> conn_;
+    Packet buffered_;       // 已从连接取出、尚未交给调用方的数据
+    size_t scanned_ = 0;    // read_until：buffered_ 的前 scanned_ 字节里已确认没有分隔符的起点
+    bool eof_ = false;
+
+public:
+    explicit InputStream(LocalPtr<TcpConnection> conn) : conn_(std::move(conn)) {}
+
+    InputStream(const InputStream&) = delete;
+    InputStream& operator=(const InputStream&) = delete;
+
+    // 对端已关闭且缓冲的数据已全部交出
+    bool eof() const { return eof_ && buffered_.size() == 0; }
+
+    // 已缓冲、尚未读取的字节数
+    size_t buffered() const { return buffered_.size(); }
+
+    Future<Packet> read_exactly(size_t n) {
+        if (buffered_.size() >= n || eof_) {
+            return Future<Packet>::make_ready(take_front(std::min(n, buffered_.size())));
+        }
+        return fill().then([self = local_from_this(), n]() {
+            return self->read_exactly(n);
+        });
+    }
+
+    Future<Packet> read_up_to(size_t n) {
+        if (buffered_.size() > 0) {
+            size_t len = std::min<size_t>(n, buffered_.fragment(0).size);
+            return Future<Packet>::make_ready(take_front(len));
+        }
+        if (eof_) return Future<Packet>::make_ready(Packet());
+        return fill().then([self = local_from_this(), n]() {
+            return self->read_up_to(n);
+        });
+    }
+
+    // 遇到 EOF 仍未找到分隔符时返回剩余的全部数据，调用方可用 eof() 区分
+    Future<Packet> read_until(std::string delim) {
+        size_t pos = find(delim, scanned_);
+        if (pos != npos) {
+            Packet frame = take_front(pos);
+            drop(delim.size());
+            return Future<Packet>::make_ready(std::move(frame));
+        }
+        // 下次从可能构成分隔符前缀的位置继续，不重复扫描已确认的部分
+        scanned_ = buffered_.size() >= delim.size() ? buffered_.size() - delim.size() + 1 : 0;
+        if (eof_) return Future<Packet>::make_ready(take_front(buffered_.size()));
+
+        return fill().then([self = local_from_this(), delim = std::move(delim)]() mutable {
+            return self->read_until(std::move(delim));
+        });
+    }
+
+    // consumer: (Packet) -> ConsumeResult
+    // 每次收到的是当前缓冲的全部数据（零拷贝，可能有多个分片）；EOF 时收到一个空 Packet，随后循环结束
+    template<typename Consumer>
+    Future<void> consume(Consumer consumer) {
+        return repeat([self = local_from_this(), consumer = std::move(consumer)]() mutable {
+            if (self->buffered_.size() > 0 || self->eof_) {
+                Packet data = std::move(self->buffered_);
+                self->buffered_ = Packet();
+                self->scanned_ = 0;
+                bool at_eof = data.size() == 0;
+
+                ConsumeResult r = consumer(std::move(data));
+                if (r.stop) {
+                    self->buffered_ = std::move(r.unconsumed);
+                    return Future<StopIteration>::make_ready(StopIteration::yes);
+                }
+                return Future<StopIteration>::make_ready(at_eof ? StopIteration::yes : StopIteration::no);
+            }
+            return self->fill().then([]() { return StopIteration::no; });
+        });
+    }
+
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    LocalPtr<InputStream> local_from_this() {
+        return LocalPtr<InputStream>(this);
+    }
+
+    // 从连接再读一批数据接到 buffered_ 后面
+    // 落在同一个 NetBuffer 里、紧接着上一批的数据由 Packet::append 并入同一个分片
+    Future<void> fill() {
+        return conn_->read().then([self = local_from_this()](Packet p) {
+            if (p.size() == 0) {
+                self->eof_ = true;
+            } else {
+                self->buffered_.append(std::move(p));
+            }
+        });
+    }
+
+    // 交出前 n 字节；跨分片的帧拷贝成一块连续内存，单分片内的直接共享
+    Packet take_front(size_t n) {
+        if (n == 0) return Packet();
+        Packet frame;
+        if (n == buffered_.size()) {
+            frame = std::move(buffered_);
+            buffered_ = Packet();
+        } else {
+            frame = buffered_.slice(0, n);
+            buffered_ = buffered_.drop_front(n);
+        }
+        scanned_ = 0;
+        if (frame.nr_frags() > 1) frame.linearize();
+        return frame;
+    }
+
+    void drop(size_t n) {
+        buffered_ = buffered_.drop_front(std::min(n, buffered_.size()));
+    }
+
+    // 在 buffered_ 的 [from, size) 中查找 delim，返回起始偏移
+    // 每个分片内用 memchr 找首字节（glibc 的实现是 SSE2/AVX2 向量化的），候选位置再逐字节确认，
+    // 确认时可以跨到后续分片，分隔符被两个接收缓冲区切开也能找到
+    size_t find(const std::string& delim, size_t from) const {
+        if (delim.empty()) return from <= buffered_.size() ? from : npos;
+        const char first = delim[0];
+        size_t base = 0;
+        for (size_t i = 0; i < buffered_.nr_frags(); ++i) {
+            const Fragment& f = buffered_.fragment(i);
+            if (base + f.size <= from) {
+                base += f.size;
+                continue;
+            }
+            const char* begin = f.data();
+            const char* end = begin + f.size;
+            const char* p = begin + (from > base ? from - base : 0);
+            while (p < end && (p = static_cast<const char*>(std::memchr(p, first, end - p)))) {
+                if (matches_at(i, p - begin, delim)) return base + (p - begin);
+                ++p;
+            }
+            base += f.size;
+        }
+        return npos;
+    }
+
+    // 从第 frag 个分片的 offset 处开始，后续字节是否等于 delim
+    bool matches_at(size_t frag, size_t offset, const std::string& delim) const {
+        size_t matched = 0;
+        for (size_t i = frag; i < buffered_.nr_frags() && matched < delim.size(); ++i, offset = 0) {
+            const Fragment& f = buffered_.fragment(i);
+            size_t n = std::min<size_t>(f.size - offset, delim.size() - matched);
+            if (std::memcmp(f.data() + offset, delim.data() + matched, n) != 0) return false;
+            matched += n;
+        }
+        return matched == delim.size();
+    }
+};
@@ -0,0 +1,638 @@
+#include "Memory.h"
+#include "Numa.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <dlfcn.h>
+#include <new>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// glibc 导出的原始实现：用于回退路径和释放不属于本分配器的指针
+extern "C" {
+void* __libc_malloc(size_t size);
+void  __libc_free(void* ptr);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t align, size_t size);
+}
+
+namespace {
+
+constexpr size_t kSpanShift = 16;
+constexpr size_t kSpanSize = size_t(1) << kSpanShift;     // 64KB
+constexpr size_t kSpanHeaderSize = 64;
+constexpr size_t kPageSize = 4096;
+
+// 8KB 以下按 2 的幂分档；8KB..32KB 的档位按"一个 span 恰好装 k 个对象"取值，
+// 中等大小的对象共享 span，不再各占一整个 64KB
+constexpr int kNumTinyClasses = 32;
+constexpr size_t kMaxTinySize = 8192;
+constexpr size_t kSpanPayload = kSpanSize - kSpanHeaderSize;
+constexpr size_t kMidClassSizes[] = {
+    kSpanPayload / 7 / 16 * 16,     // 9344
+    kSpanPayload / 6 / 16 * 16,     // 10912
+    kSpanPayload / 5 / 16 * 16,     // 13088
+    kSpanPayload / 4 / 16 * 16,     // 16368
+    kSpanPayload / 3 / 16 * 16,     // 21824
+    kSpanPayload / 2 / 16 * 16,     // 32736
+};
+constexpr int kNumMidClasses = sizeof(kMidClassSizes) / sizeof(kMidClassSizes[0]);
+constexpr int kNumClasses = kNumTinyClasses + kNumMidClasses;
+constexpr size_t kMaxSmallSize = kMidClassSizes[kNumMidClasses - 1];
+
+constexpr int kLargeBins = 64;                          // 1..64 个 span 按长度分桶
+constexpr size_t kMadviseThreshold = 16;                // >= 1MB 的大段释放时归还物理页
+
+constexpr int kMaxShards = 64;
+constexpr size_t kShardRegionSize = size_t(32) << 30;   // 每个 shard 32GB 虚拟地址
+constexpr size_t kSpansPerShard = kShardRegionSize >> kSpanShift;
+
+constexpr size_t kBindGranule = size_t(2) << 20;        // 区域按 2MB 粒度绑定 NUMA 节点
+
+constexpr uint32_t kSpanMagic = 0x5eaa57a2;
+constexpr uint16_t kSmallSpan = 1;
+constexpr uint16_t kLargeSpan = 2;
+
+// shard 槽位的归属；线程退出后槽位连同其中的内存留给下一个线程接手
+constexpr int kSlotUnused = 0;
+constexpr int kSlotOwned = 1;
+constexpr int kSlotOrphaned = 2;         // owner 已退出，等待接手
+constexpr int kSlotDraining = 3;         // 其他线程正在替退出的 owner 收回跨 shard 释放
+
+// 每个 span 起始处的头部；span 按 64KB 对齐，任意对象地址抹掉低 16 位即可找到它
+struct SpanHeader {
+    uint32_t magic;
+    uint16_t kind;
+    uint16_t size_class;
+    uint32_t nspans;
+    uint32_t offset;          // 大对象：对象相对 span 起点的偏移（支持对齐分配）
+    SpanHeader* next;         // 空闲段双向链表
+    SpanHeader* prev;
+};
+static_assert(sizeof(SpanHeader) <= kSpanHeaderSize, "SpanHeader too large");
+
+struct FreeObject {
+    FreeObject* next;
+};
+
+// 单个 shard 的全部状态；除 remote_head/state 外只被 owner 线程（或持有 kSlotDraining 的线程）访问
+// 所有成员都有常量初始化器，保证 g_shards 是常量初始化（BSS），
+// 不会在 malloc 已经被调用之后再跑一次动态初始化
+struct alignas(64) Shard {
+    FreeObject* free_lists[kNumClasses] = {};
+    char* slab_cursor[kNumClasses] = {};     // 当前 slab 中尚未切分的位置（按需切分，不预先触碰页）
+    char* slab_end[kNumClasses] = {};
+
+    SpanHeader* large_bins[kLargeBins + 1] = {};
+    uint64_t bin_mask = 0;                   // 第 n-1 位：large_bins[n] 非空
+    SpanHeader* huge_runs = nullptr;         // > kLargeBins 个 span 的空闲段，first-fit + 切分
+
+    // 空闲段的首尾 span 记录段长，其余为 0；释放时据此找到左右相邻的空闲段并合并
+    uint32_t* span_map = nullptr;
+
+    char* region_begin = nullptr;
+    char* next_span = nullptr;
+    char* region_end = nullptr;
+    char* bound_end = nullptr;               // [region 起点, bound_end) 已绑定到本 shard 的节点
+
+    memory::Stats stats;
+
+    alignas(64) std::atomic<FreeObject*> remote_head{nullptr};
+    std::atomic<int> state{kSlotUnused};
+};
+
+Shard g_shards[kMaxShards];
+char* g_region_base = nullptr;
+std::atomic<int> g_init_state{0};        // 0 未初始化，1 初始化中，2 就绪，3 失败（回退 glibc）
+pthread_key_t g_exit_key;                // 析构函数在线程退出时交还 shard 槽位
+
+// -1：尚未分配 shard；-2：回退 glibc
+__thread int tls_shard __attribute__((tls_model("initial-exec"))) = -1;
+
+inline size_t class_size(int c) {
+    if (c >= kNumTinyClasses) return kMidClassSizes[c - kNumTinyClasses];
+    if (c < 8) return size_t(c + 1) * 16;
+    int lg = 7 + (c - 8) / 4;
+    int idx = (c - 8) % 4;
+    return (size_t(1) << lg) + size_t(idx + 1) * (size_t(1) << (lg - 2));
+}
+
+// 0..128 按 16 字节一档，之后每个 2 的幂区间分 4 档（最大浪费 25%），8KB 以上查表
+inline int size_class(size_t size) {
+    if (size <= 128) return size == 0 ? 0 : int((size + 15) >> 4) - 1;
+    if (size > kMaxTinySize) {
+        int c = 0;
+        while (kMidClassSizes[c] < size) ++c;
+        return kNumTinyClasses + c;
+    }
+    int lg = 63 - __builtin_clzl(size - 1);
+    size_t step = size_t(1) << (lg - 2);
+    int idx = int((size - 1 - (size_t(1) << lg)) / step);
+    return 8 + (lg - 7) * 4 + idx;
+}
+
+inline SpanHeader* span_of(const void* p) {
+    return reinterpret_cast<SpanHeader*>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(kSpanSize - 1));
+}
+
+inline bool in_region(const void* p) {
+    const char* c = static_cast<const char*>(p);
+    return g_region_base && c >= g_region_base && c < g_region_base + kShardRegionSize * kMaxShards;
+}
+
+inline int owner_of(const void* p) {
+    return int((static_cast<const char*>(p) - g_region_base) / kShardRegionSize);
+}
+
+void release_slot(void* arg);
+
+bool init_region() {
+    int expected = 0;
+    if (g_init_state.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+        // 一次性保留所有 shard 的地址空间（NORESERVE，不计入 commit，首次触碰才分配物理页）
+        size_t total = kShardRegionSize * kMaxShards;
+        void* p = ::mmap(nullptr, total + kSpanSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        // span_map：每个 span 4 字节，同样只在用到时才分配物理页
+        void* map = ::mmap(nullptr, kSpansPerShard * kMaxShards * sizeof(uint32_t), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED || map == MAP_FAILED || pthread_key_create(&g_exit_key, release_slot) != 0) {
+            g_init_state.store(3, std::memory_order_release);
+            return false;
+        }
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(p) + kSpanSize - 1) & ~(uintptr_t)(kSpanSize - 1);
+        g_region_base = reinterpret_cast<char*>(aligned);
+        for (int i = 0; i < kMaxShards; ++i) {
+            g_shards[i].span_map = static_cast<uint32_t*>(map) + kSpansPerShard * i;
+            g_shards[i].region_begin = g_region_base + kShardRegionSize * i;
+            g_shards[i].next_span = g_shards[i].region_begin;
+            g_shards[i].region_end = g_shards[i].next_span + kShardRegionSize;
+            g_shards[i].bound_end = g_shards[i].next_span;
+        }
+        g_init_state.store(2, std::memory_order_release);
+        return true;
+    }
+    while ((expected = g_init_state.load(std::memory_order_acquire)) == 1) {
+        // 另一个线程正在初始化
+    }
+    return expected == 2;
+}
+
+void drain_remote(Shard* s);
+
+// 占一个 shard 槽位：优先接手已退出线程留下的槽位，它已经切出的 span 和空闲链表可以直接复用
+int acquire_slot() {
+    const int order[] = {kSlotOrphaned, kSlotUnused};
+    for (int from : order) {
+        for (int i = 0; i < kMaxShards; ++i) {
+            int expected = from;
+            if (g_shards[i].state.compare_exchange_strong(expected, kSlotOwned, std::memory_order_acq_rel)) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// 当前线程的 shard；nullptr 表示走 glibc
+inline Shard* local_shard() {
+    int id = tls_shard;
+    if (__builtin_expect(id >= 0, 1)) return &g_shards[id];
+    if (id == -2) return nullptr;
+
+    if (g_init_state.load(std::memory_order_acquire) != 2 && !init_region()) {
+        tls_shard = -2;
+        return nullptr;
+    }
+    id = acquire_slot();
+    if (id < 0) {
+        tls_shard = -2;
+        return nullptr;
+    }
+    tls_shard = id;
+    Shard* s = &g_shards[id];
+    // 统计从接手时重新开始；前任留下、尚未收回的跨 shard 释放先收回来
+    size_t region_used = s->stats.region_used;
+    s->stats = memory::Stats();
+    s->stats.region_used = region_used;
+    drain_remote(s);
+    // 先设置 tls_shard 再注册：pthread_setspecific 内部如果分配内存，直接用这个 shard
+    pthread_setspecific(g_exit_key, s);
+    return s;
+}
+
+// 没有 owner 的 shard 由释放者代为收回：抢到 kSlotDraining 的线程独占它的空闲结构
+void drain_orphan(Shard* s) {
+    while (s->remote_head.load(std::memory_order_seq_cst) != nullptr) {
+        int expected = kSlotOrphaned;
+        if (!s->state.compare_exchange_strong(expected, kSlotDraining, std::memory_order_seq_cst)) return;
+        drain_remote(s);
+        // 放回 kSlotOrphaned 之后再检查一次：期间推进来、但看到 kSlotDraining 而离开的释放由这里收回
+        s->state.store(kSlotOrphaned, std::memory_order_seq_cst);
+    }
+}
+
+// 线程退出：收回最后一批跨 shard 释放，把槽位交给后来的线程
+// 之后本线程的分配走 glibc，释放按跨 shard 处理
+void release_slot(void* arg) {
+    auto* s = static_cast<Shard*>(arg);
+    drain_remote(s);
+    tls_shard = -2;
+    s->state.store(kSlotOrphaned, std::memory_order_seq_cst);
+    drain_orphan(s);
+}
+
+inline size_t span_index(Shard* s, const SpanHeader* h) {
+    return size_t(reinterpret_cast<const char*>(h) - s->region_begin) >> kSpanShift;
+}
+
+inline SpanHeader* span_at(Shard* s, size_t idx) {
+    return reinterpret_cast<SpanHeader*>(s->region_begin + (idx << kSpanShift));
+}
+
+SpanHeader* carve_spans(Shard* s, size_t nspans) {
+    size_t bytes = nspans * kSpanSize;
+    if (s->next_span + bytes > s->region_end) return nullptr;
+    // 区域在 shard 第一次 malloc 时就分好了，那时线程可能还没钉核；
+    // 所以按 2MB 粒度在切出新 span 时才绑定，绑定发生在首次触碰之前，用的是当时所在的节点
+    if (s->next_span + bytes > s->bound_end) {
+        uintptr_t end = (reinterpret_cast<uintptr_t>(s->next_span + bytes) + kBindGranule - 1) & ~(uintptr_t)(kBindGranule - 1);
+        char* new_end = reinterpret_cast<char*>(end);
+        if (new_end > s->region_end) new_end = s->region_end;
+        numa::bind_local(s->bound_end, size_t(new_end - s->bound_end));
+        s->bound_end = new_end;
+    }
+    auto* h = reinterpret_cast<SpanHeader*>(s->next_span);
+    s->next_span += bytes;
+    s->stats.region_used += bytes;
+    h->magic = kSpanMagic;
+    h->nspans = static_cast<uint32_t>(nspans);
+    h->next = nullptr;
+    return h;
+}
+
+inline SpanHeader** free_list_of(Shard* s, size_t nspans) {
+    return nspans <= kLargeBins ? &s->large_bins[nspans] : &s->huge_runs;
+}
+
+// 空闲段入链并在首尾 span 记录段长
+void insert_free_run(Shard* s, SpanHeader* h, size_t nspans) {
+    h->magic = kSpanMagic;
+    h->kind = 0;
+    h->nspans = static_cast<uint32_t>(nspans);
+    size_t idx = span_index(s, h);
+    s->span_map[idx] = static_cast<uint32_t>(nspans);
+    s->span_map[idx + nspans - 1] = static_cast<uint32_t>(nspans);
+
+    SpanHeader** head = free_list_of(s, nspans);
+    h->prev = nullptr;
+    h->next = *head;
+    if (*head) (*head)->prev = h;
+    *head = h;
+    if (nspans <= kLargeBins) s->bin_mask |= uint64_t(1) << (nspans - 1);
+}
+
+// 空闲段出链并清掉首尾标记
+void remove_free_run(Shard* s, SpanHeader* h) {
+    size_t nspans = h->nspans;
+    size_t idx = span_index(s, h);
+    s->span_map[idx] = 0;
+    s->span_map[idx + nspans - 1] = 0;
+
+    if (h->prev) h->prev->next = h->next;
+    else *free_list_of(s, nspans) = h->next;
+    if (h->next) h->next->prev = h->prev;
+    if (nspans <= kLargeBins && !s->large_bins[nspans]) s->bin_mask &= ~(uint64_t(1) << (nspans - 1));
+}
+
+// 从空闲段 h 的头部切出 nspans 个 span，剩余部分放回空闲结构
+SpanHeader* take_run(Shard* s, SpanHeader* h, size_t nspans) {
+    remove_free_run(s, h);
+    if (h->nspans > nspans) {
+        insert_free_run(s, span_at(s, span_index(s, h) + nspans), h->nspans - nspans);
+        h->nspans = static_cast<uint32_t>(nspans);
+    }
+    return h;
+}
+
+SpanHeader* alloc_spans(Shard* s, size_t nspans) {
+    // best-fit：长度 >= nspans 的最短非空桶
+    if (nspans <= kLargeBins) {
+        uint64_t candidates = s->bin_mask & ~((uint64_t(1) << (nspans - 1)) - 1);
+        if (candidates) return take_run(s, s->large_bins[__builtin_ctzll(candidates) + 1], nspans);
+    }
+
+    // first-fit：从大段里切
+    for (SpanHeader* h = s->huge_runs; h; h = h->next) {
+        if (h->nspans >= nspans) return take_run(s, h, nspans);
+    }
+    return carve_spans(s, nspans);
+}
+
+// 归还一段 span：与左右相邻的空闲段合并；紧挨着未切分区域的直接退回给它
+void release_spans(Shard* s, SpanHeader* h) {
+    size_t idx = span_index(s, h);
+    size_t nspans = h->nspans;
+
+    if (idx > 0 && s->span_map[idx - 1]) {
+        SpanHeader* left = span_at(s, idx - s->span_map[idx - 1]);
+        remove_free_run(s, left);
+        idx = span_index(s, left);
+        nspans += left->nspans;
+    }
+    char* end = s->region_begin + ((idx + nspans) << kSpanShift);
+    if (end == s->next_span) {
+        s->next_span = s->region_begin + (idx << kSpanShift);
+        s->stats.region_used -= nspans * kSpanSize;
+        return;
+    }
+    if (s->span_map[idx + nspans]) {
+        SpanHeader* right = span_at(s, idx + nspans);
+        nspans += right->nspans;
+        remove_free_run(s, right);
+    }
+    insert_free_run(s, span_at(s, idx), nspans);
+}
+
+void* alloc_large(Shard* s, size_t size, size_t align) {
+    size_t offset = align > kSpanHeaderSize ? align : kSpanHeaderSize;
+    if (offset >= kSpanSize) return nullptr;
+    size_t nspans = (offset + size + kSpanSize - 1) >> kSpanShift;
+
+    SpanHeader* h = alloc_spans(s, nspans);
+    if (!h) return nullptr;
+    h->kind = kLargeSpan;
+    h->size_class = 0;
+    h->offset = static_cast<uint32_t>(offset);
+    ++s->stats.large_allocs;
+    return reinterpret_cast<char*>(h) + offset;
+}
+
+void refill_class(Shard* s, int c) {
+    SpanHeader* h = alloc_spans(s, 1);
+    if (!h) return;
+    h->kind = kSmallSpan;
+    h->size_class = static_cast<uint16_t>(c);
+    h->offset = kSpanHeaderSize;
+    s->slab_cursor[c] = reinterpret_cast<char*>(h) + kSpanHeaderSize;
+    s->slab_end[c] = reinterpret_cast<char*>(h) + kSpanSize;
+}
+
+void* alloc_small(Shard* s, int c) {
+    FreeObject* obj = s->free_lists[c];
+    if (__builtin_expect(obj != nullptr, 1)) {
+        s->free_lists[c] = obj->next;
+        return obj;
+    }
+
+    size_t cs = class_size(c);
+    if (s->slab_cursor[c] + cs > s->slab_end[c]) {
+        drain_remote(s);
+        if ((obj = s->free_lists[c])) {
+            s->free_lists[c] = obj->next;
+            return obj;
+        }
+        refill_class(s, c);
+        if (s->slab_cursor[c] + cs > s->slab_end[c]) return nullptr;
+    }
+    void* p = s->slab_cursor[c];
+    s->slab_cursor[c] += cs;
+    return p;
+}
+
+void free_local(Shard* s, void* p) {
+    SpanHeader* h = span_of(p);
+    if (h->kind == kSmallSpan) {
+        auto* obj = static_cast<FreeObject*>(p);
+        obj->next = s->free_lists[h->size_class];
+        s->free_lists[h->size_class] = obj;
+        return;
+    }
+
+    // 大段：足够大的把页还给内核（保留头部所在的第一页）
+    if (h->nspans >= kMadviseThreshold) {
+        ::madvise(reinterpret_cast<char*>(h) + kPageSize, h->nspans * kSpanSize - kPageSize, MADV_DONTNEED);
+    }
+    release_spans(s, h);
+}
+
+void drain_remote(Shard* s) {
+    if (s->remote_head.load(std::memory_order_relaxed) == nullptr) return;
+    FreeObject* obj = s->remote_head.exchange(nullptr, std::memory_order_acquire);
+    while (obj) {
+        FreeObject* next = obj->next;
+        free_local(s, obj);
+        obj = next;
+    }
+}
+
+void push_remote(Shard* owner, void* p) {
+    auto* obj = static_cast<FreeObject*>(p);
+    FreeObject* old = owner->remote_head.load(std::memory_order_relaxed);
+    do {
+        obj->next = old;
+    } while (!owner->remote_head.compare_exchange_weak(old, obj, std::memory_order_seq_cst,
+                                                       std::memory_order_relaxed));
+}
+
+void* do_malloc(size_t size, size_t align) {
+    Shard* s = local_shard();
+    if (!s) return align <= 16 ? __libc_malloc(size) : __libc_memalign(align, size);
+
+    ++s->stats.mallocs;
+    void* p = nullptr;
+    if (size <= kMaxSmallSize && align <= 64) {
+        // 对齐要求 <= 64：选一个大小是 align 整数倍的 class（slab 内对象起点 64 字节对齐）
+        int c = size_class(size < align ? align : size);
+        while (c < kNumClasses && class_size(c) % align != 0) ++c;
+        if (c < kNumClasses) p = alloc_small(s, c);
+        else p = alloc_large(s, size, align);
+    } else {
+        p = alloc_large(s, size, align);
+    }
+
+    if (!p) {
+        // 区域耗尽或对齐过大：交给 glibc
+        return align <= 16 ? __libc_malloc(size) : __libc_memalign(align, size);
+    }
+    return p;
+}
+
+void do_free(void* p) {
+    if (!p) return;
+    if (!in_region(p)) {
+        __libc_free(p);
+        return;
+    }
+
+    Shard* s = local_shard();
+    Shard* owner = &g_shards[owner_of(p)];
+    if (s) ++s->stats.frees;
+    if (owner == s) {
+        free_local(s, p);
+        return;
+    }
+    if (s) ++s->stats.cross_shard_frees;
+    push_remote(owner, p);
+    // owner 已经退出：与 release_slot / drain_orphan 中"先改 state 再查 remote_head"配对，
+    // 两边至少有一方看到对方，推进来的内存不会无人收回
+    if (owner->state.load(std::memory_order_seq_cst) == kSlotOrphaned) drain_orphan(owner);
+}
+
+// 不属于本分配器的指针：问 glibc 自己的 malloc_usable_size（本文件导出的同名符号遮住了它）
+size_t libc_usable_size(void* p) {
+    using Fn = size_t (*)(void*);
+    static std::atomic<Fn> fn{nullptr};
+    Fn f = fn.load(std::memory_order_acquire);
+    if (!f) {
+        f = reinterpret_cast<Fn>(::dlsym(RTLD_NEXT, "malloc_usable_size"));
+        if (!f) return 0;
+        fn.store(f, std::memory_order_release);
+    }
+    return f(p);
+}
+
+size_t usable_size(void* p) {
+    if (!p) return 0;
+    if (!in_region(p)) return libc_usable_size(p);
+    SpanHeader* h = span_of(p);
+    if (h->kind == kSmallSpan) return class_size(h->size_class);
+    return h->nspans * kSpanSize - h->offset;
+}
+
+} // namespace
+
+namespace memory {
+
+void drain_remote_frees() {
+    int id = tls_shard;
+    if (id >= 0) drain_remote(&g_shards[id]);
+}
+
+Stats stats() {
+    int id = tls_shard;
+    if (id >= 0) return g_shards[id].stats;
+    return Stats();
+}
+
+} // namespace memory
+
+extern "C" {
+
+void* malloc(size_t size) {
+    return do_malloc(size, 16);
+}
+
+void free(void* p) {
+    do_free(p);
+}
+
+void* calloc(size_t n, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(n, size, &total)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    void* p = do_malloc(total, 16);
+    if (p) std::memset(p, 0, total);
+    return p;
+}
+
+void* realloc(void* p, size_t size) {
+    if (!p) return do_malloc(size, 16);
+    if (size == 0) {
+        do_free(p);
+        return nullptr;
+    }
+    if (!in_region(p)) return __libc_realloc(p, size);
+
+    size_t old = usable_size(p);
+    if (size <= old) return p;
+    void* np = do_malloc(size, 16);
+    if (!np) return nullptr;
+    std::memcpy(np, p, old);
+    do_free(p);
+    return np;
+}
+
+void* reallocarray(void* p, size_t n, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(n, size, &total)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(p, total);
+}
+
+void* memalign(size_t align, size_t size) {
+    if (align < 16) align = 16;
+    return do_malloc(size, align);
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+    return memalign(align, size);
+}
+
+int posix_memalign(void** out, size_t align, size_t size) {
+    if (align < sizeof(void*) || (align & (align - 1)) != 0) return EINVAL;
+    void* p = memalign(align, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void* valloc(size_t size) {
+    return memalign(kPageSize, size);
+}
+
+void* pvalloc(size_t size) {
+    return memalign(kPageSize, (size + kPageSize - 1) & ~(kPageSize - 1));
+}
+
+size_t malloc_usable_size(void* p) {
+    return usable_size(p);
+}
+
+} // extern "C"
+
+// operator new/delete 直接走本分配器，省掉 libstdc++ 到 malloc 的一跳
+void* operator new(size_t size) {
+    void* p = do_malloc(size, 16);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    void* p = do_malloc(size, 16);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return do_malloc(size, 16);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return do_malloc(size, 16);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    void* p = do_malloc(size, static_cast<size_t>(align) < 16 ? 16 : static_cast<size_t>(align));
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void operator delete(void* p) noexcept { do_free(p); }
+void operator delete[](void* p) noexcept { do_free(p); }
+void operator delete(void* p, size_t) noexcept { do_free(p); }
+void operator delete[](void* p, size_t) noexcept { do_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { do_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { do_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { do_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { do_free(p); }
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 可选的 per-shard 通用内存分配器（Memory.cpp）
+ *
+ * 只有继承 Poolable 的类型能绕开全局堆；std::function 的捕获、std::deque 的块、
+ * std::string 等仍然走 glibc malloc 及其跨线程 arena。把 Memory.cpp 一起链接进来，
+ * 就会在进程范围内替换 malloc/free/operator new/delete：
+ *   g++ -O3 main.cpp Reactor.cpp Memory.cpp -o mini_seastar -lpthread
+ * 不链接则完全使用 glibc，便于 A/B 对比
+ *
+ * 每个线程（shard）独占一段连续的虚拟地址区域：
+ *   - 小对象（<= 32KB）按 size class 从 64KB slab 中切分，每个 class 一条 LIFO 空闲链表；
+ *     8KB 以上的档位按一个 span 装下整数个对象取值
+ *   - 大对象按 64KB span 成段分配，best-fit 复用并切分；释放时与相邻空闲段合并，
+ *     大段释放时 MADV_DONTNEED
+ *   - 指针所属 shard 由地址直接算出；跨 shard 释放推入 owner 的无锁队列，
+ *     由 owner 在 Reactor::run 每轮或分配慢路径中收回
+ *   - 线程退出时交还 shard 槽位，后来的线程优先接手；无人接手期间，
+ *     跨 shard 释放由释放者代为收回
+ * 同时存活的线程超出 shard 上限、以及初始化失败时，回退到 glibc
+ */
+namespace memory {
+
+struct Stats {
+    uint64_t mallocs = 0;
+    uint64_t frees = 0;
+    uint64_t cross_shard_frees = 0;   // 本 shard 释放的、属于其他 shard 的内存
+    uint64_t large_allocs = 0;
+    size_t region_used = 0;           // 已从本 shard 区域切出的字节数
+};
+
+// 以下符号为弱引用：未链接 Memory.cpp 时为 nullptr，调用前需判空
+__attribute__((weak)) void drain_remote_frees();
+__attribute__((weak)) Stats stats();
+
+inline bool enabled() { return &drain_remote_frees != nullptr; }
+
+} // namespace memory
@@ -1,24 +1,123 @@
 #pragma once
+#include <type_traits>
 #include "Poolable.h"
+#include "Packet.h"
+#include "BufferLimits.h"
 
-// 继承自 Poolable，享受对象池的 O(1) 极速分配
-class NetBuffer : public Poolable<NetBuffer> {
+// 接收缓冲区，按大小分级：1KB / 4KB / 16KB / 64KB
+// 每一级是一个独立的 Poolable 类型，享受对象池的 O(1) 极速分配；连接根据最近的读取量选级，
+// 闲聊式的小请求只占 1KB，大块上传用 64KB 减少 read 次数
+// 头部复用 PacketBuffer：read() 交出去的 Packet 直接引用这里的内存（零拷贝接收），
+// 连接持有一个引用，每个分片各持有一个，最后一个引用消失时才归还对象池
+class NetBuffer {
 public:
-    static constexpr size_t kBufferSize = 16384; 
-    
-    char data_[kBufferSize];
+    static constexpr int kNumClasses = 4;
+    static constexpr size_t kClassSizes[kNumClasses] = {1024, 4096, 16384, 65536};
+
+    PacketBuffer header_;
     size_t read_index_ = 0;
     size_t write_index_ = 0;
+    // 读入的字节计入读取方 shard 的预算，最后一个引用消失（或整块从头复用）时才归还：
+    // 零拷贝交出去的 Packet 仍然钉着这块内存
+    ShardBufferBudget* budget_ = nullptr;
+    size_t charged_ = 0;
+
+    NetBuffer(char* data, size_t capacity, void (*free_fn)(PacketBuffer*)) {
+        header_.refs = 1;
+        header_.capacity = static_cast<uint32_t>(capacity);
+        header_.owner = PacketBuffer::local_owner();
+        header_.free_fn = free_fn;
+        header_.base = data;
+    }
+
+    NetBuffer(const NetBuffer&) = delete;
+    NetBuffer& operator=(const NetBuffer&) = delete;
+
+    // 能容纳 bytes 字节的最小一级（超过最大一级时取最大一级）
+    static int class_for(size_t bytes) {
+        for (int i = 0; i < kNumClasses; ++i) {
+            if (bytes <= kClassSizes[i]) return i;
+        }
+        return kNumClasses - 1;
+    }
+
+    static NetBuffer* create(int size_class);
+
+    size_t capacity() const { return header_.capacity; }
 
     // 获取可读和可写字节数
     size_t readable_bytes() const { return write_index_ - read_index_; }
-    size_t writable_bytes() const { return kBufferSize - write_index_; }
+    size_t writable_bytes() const { return capacity() - write_index_; }
 
     // 获取读写指针
-    char* read_ptr() { return data_ + read_index_; }
-    char* write_ptr() { return data_ + write_index_; }
+    char* read_ptr() { return header_.base + read_index_; }
+    char* write_ptr() { return header_.base + write_index_; }
 
     // 移动指针
     void retrieve(size_t len) { read_index_ += len; }
     void append(size_t len) { write_index_ += len; }
-};
\ No newline at end of file
+
+    // 把 [read_ptr, read_ptr + len) 作为 Packet 交出去并消费掉，不复制
+    Packet take(size_t len) {
+        Packet p = Packet::wrap(&header_, read_index_, len);
+        read_index_ += len;
+        return p;
+    }
+
+    // 数据已读空且没有 Packet 还在引用时，整块从头复用
+    void maybe_rewind() {
+        if (read_index_ == write_index_ && header_.refs == 1) {
+            read_index_ = write_index_ = 0;
+            release_charge();
+        }
+    }
+
+    // 刚读入 n 字节
+    void charge(size_t n) {
+        if (!budget_) budget_ = &ShardBufferBudget::local();
+        budget_->charge(n);
+        charged_ += n;
+    }
+
+    // buffer 可能经 ForeignPacket 移交，在别的 shard 上释放，此时交给原 shard 异步收回
+    void release_charge() {
+        if (charged_ == 0) return;
+        if (budget_ == &ShardBufferBudget::local()) {
+            budget_->release(charged_);
+        } else {
+            budget_->release_remote(charged_);
+        }
+        charged_ = 0;
+    }
+
+    // 连接放弃自己的引用；仍被 Packet 引用时由最后一个 Packet 归还
+    void unref() {
+        header_.check_owner();
+        if (--header_.refs == 0) header_.free_fn(&header_);
+    }
+};
+
+// 某一级缓冲区在对象池中的实际布局：NetBuffer 头部后面紧跟数据区
+template<size_t N>
+struct NetBufferBlock : public Poolable<NetBufferBlock<N>, packet_detail::nodes_per_chunk(N)> {
+    NetBuffer buf;
+    char data[N];
+
+    NetBufferBlock() : buf(data, N, &NetBufferBlock::release) {}
+
+    static void release(PacketBuffer* b) {
+        static_assert(std::is_standard_layout<NetBufferBlock>::value, "buf must be the first member");
+        NetBufferBlock* block = reinterpret_cast<NetBufferBlock*>(b);
+        block->buf.release_charge();
+        delete block;
+    }
+};
+
+inline NetBuffer* NetBuffer::create(int size_class) {
+    switch (size_class) {
+        case 0: return &(new NetBufferBlock<1024>())->buf;
+        case 1: return &(new NetBufferBlock<4096>())->buf;
+        case 2: return &(new NetBufferBlock<16384>())->buf;
+        default: return &(new NetBufferBlock<65536>())->buf;
+    }
+}
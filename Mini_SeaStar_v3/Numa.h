@@ -0,0 +1,131 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * NUMA 亲和：让 shard 的内存留在 shard 所在的节点上
+ * Engine 把线程钉在各个核上，但池 chunk、per-shard 区域和收包缓冲区如果落在另一个
+ * socket 的内存上，每次访问都要跨 QPI/UPI。这里直接用 mbind/move_pages/getcpu 系统调用
+ * （不依赖 libnuma），并且不做任何堆分配，Memory.cpp 的 malloc 内部也可以调用
+ *
+ * 单节点机器上 bind_local 和 sample 直接返回，不产生额外系统调用
+ */
+namespace numa {
+
+// mbind 的策略取值（<linux/mempolicy.h>），不引入头文件以免宏与 <numaif.h> 冲突
+constexpr int kMpolPreferred = 1;
+constexpr int kMpolBind = 2;
+
+struct NumaConfig {
+    // 关闭后完全依赖内核默认策略（first-touch）
+    static inline bool enabled = true;
+    // true：kMpolBind，本节点内存耗尽时分配失败；false：kMpolPreferred，不足时回退到其他节点
+    static inline bool strict = false;
+};
+
+// 系统中在线的 NUMA 节点数（解析 /sys/devices/system/node/online，例如 "0-1"）
+inline int node_count() {
+    static int count = [] {
+        int fd = ::open("/sys/devices/system/node/online", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return 1;
+        char buf[64] = {};
+        ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+        ::close(fd);
+        if (n <= 0) return 1;
+
+        // 取最大的节点编号 + 1
+        int max_node = 0, cur = 0;
+        bool in_num = false;
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buf[i] >= '0' && buf[i] <= '9') {
+                cur = cur * 10 + (buf[i] - '0');
+                in_num = true;
+            } else {
+                if (in_num && cur > max_node) max_node = cur;
+                cur = 0;
+                in_num = false;
+            }
+        }
+        if (in_num && cur > max_node) max_node = cur;
+        return max_node + 1;
+    }();
+    return count;
+}
+
+// 当前线程所在的节点（线程已被钉核，所以结果稳定）
+inline int current_node() {
+    unsigned cpu = 0, node = 0;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return static_cast<int>(node);
+}
+
+// shard 的节点在钉核后缓存一次；Engine 钉核后调用 refresh_local_node()
+inline int& local_node_slot() {
+    static thread_local int node = -1;
+    return node;
+}
+
+inline int refresh_local_node() {
+    local_node_slot() = current_node();
+    return local_node_slot();
+}
+
+inline int local_node() {
+    int node = local_node_slot();
+    return node >= 0 ? node : refresh_local_node();
+}
+
+// 把 [addr, addr+len) 绑定到指定节点；必须在首次触碰之前调用才能决定物理页的位置
+inline bool bind_to_node(void* addr, size_t len, int node) {
+    if (!NumaConfig::enabled || node_count() <= 1 || node < 0 || node >= 64) return false;
+    unsigned long mask = 1UL << node;
+    int mode = NumaConfig::strict ? kMpolBind : kMpolPreferred;
+    return ::syscall(SYS_mbind, addr, len, mode, &mask, sizeof(mask) * 8, 0) == 0;
+}
+
+inline bool bind_local(void* addr, size_t len) {
+    if (!NumaConfig::enabled || node_count() <= 1) return false;
+    return bind_to_node(addr, len, local_node());
+}
+
+// 查询某个地址当前所在的节点（页尚未分配时返回 -1）
+inline int node_of(const void* addr) {
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(addr) & ~uintptr_t(4095));
+    int status = -1;
+    if (::syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0) return -1;
+    return status;
+}
+
+/**
+ * 远端访问统计：热路径按采样率调用 sample()，用 move_pages 查询被访问的缓冲区
+ * 落在哪个节点，累计本 shard 访问了多少远端内存（collect_pool_stats 一并汇总）
+ */
+struct AccessStats {
+    uint64_t sampled = 0;
+    uint64_t remote = 0;
+};
+
+inline AccessStats& access_stats() {
+    static thread_local AccessStats stats;
+    return stats;
+}
+
+constexpr uint32_t kSampleEvery = 1024;
+
+inline void sample(const void* addr) {
+    if (!NumaConfig::enabled || node_count() <= 1) return;
+    static thread_local uint32_t tick = 0;
+    if (++tick < kSampleEvery) return;
+    tick = 0;
+
+    int node = node_of(addr);
+    if (node < 0) return;
+    auto& st = access_stats();
+    ++st.sampled;
+    if (node != local_node()) ++st.remote;
+}
+
+} // namespace numa
@@ -3,51 +3,299 @@
 #include <cstring>
 #include <string>
 #include <iostream>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+#include <sys/uio.h>
+#include "Poolable.h"
 
+/**
+ * Packet 的底层 buffer：头部和数据放在同一块内存里，引用计数是普通整数
+ * 与 LocalPtr 一样只允许在所属 shard 上 share/slice/析构，省掉 shared_ptr 的
+ * 控制块分配和 lock xadd。跨 shard 传递必须走 ForeignPacket
+ */
+struct PacketBuffer {
+    uint32_t refs;
+    uint32_t capacity;
+    const void* owner;                   // 所属 shard 的标识；nullptr 表示正在跨 shard 移交
+    void (*free_fn)(PacketBuffer*);      // 最后一个引用消失时如何回收（不同 size class / 外部内存）
+    char* base;
+
+    // 当前线程的标识：取一个 thread_local 变量的地址，不依赖 Reactor
+    static const void* local_owner() {
+        static thread_local char token;
+        return &token;
+    }
+
+    void check_owner() const {
+        assert(owner == local_owner() && "Packet buffer used on a foreign shard, use ForeignPacket");
+    }
+};
+
+namespace packet_detail {
+
+// 每个 size class 的 chunk 大约 256KB，节点数随块大小缩放；开大页时对象池再把 chunk 放大到 2MB
+constexpr size_t kBlockChunkBytes = 256 * 1024;
+
+constexpr size_t nodes_per_chunk(size_t bytes) {
+    size_t n = kBlockChunkBytes / (bytes + sizeof(PacketBuffer));
+    return n < 16 ? 16 : n;
+}
+
+// 头部 + 数据一起从对象池分配：一次 O(1) 分配，数据紧跟在头部之后
+template<size_t N>
+struct PacketBlock : public Poolable<PacketBlock<N>, nodes_per_chunk(N)> {
+    PacketBuffer header;
+    char bytes[N];
+
+    static void release(PacketBuffer* b) {
+        delete reinterpret_cast<PacketBlock*>(b);
+    }
+};
+
+// 超过最大 size class 的 buffer 直接走 operator new，头部同样与数据相邻
+inline void release_large(PacketBuffer* b) {
+    b->~PacketBuffer();
+    ::operator delete(static_cast<void*>(b));
+}
+
+template<size_t N>
+PacketBuffer* make_block() {
+    static_assert(std::is_standard_layout<PacketBlock<N>>::value, "header must be the first member");
+    auto* blk = new PacketBlock<N>; // 默认初始化，不清零数据区
+    blk->header.capacity = N;
+    blk->header.free_fn = &PacketBlock<N>::release;
+    blk->header.base = blk->bytes;
+    return &blk->header;
+}
+
+inline PacketBuffer* allocate_buffer(size_t size) {
+    PacketBuffer* b;
+    if (size <= 256) b = make_block<256>();
+    else if (size <= 1024) b = make_block<1024>();
+    else if (size <= 4096) b = make_block<4096>();
+    else if (size <= 16384) b = make_block<16384>();
+    else if (size <= 65536) b = make_block<65536>();
+    else {
+        void* mem = ::operator new(sizeof(PacketBuffer) + size);
+        b = new (mem) PacketBuffer();
+        b->capacity = static_cast<uint32_t>(size);
+        b->free_fn = &release_large;
+        b->base = reinterpret_cast<char*>(b + 1);
+    }
+    b->refs = 1;
+    b->owner = PacketBuffer::local_owner();
+    return b;
+}
+
+} // namespace packet_detail
+
+// Packet 的一个分片：引用某个 PacketBuffer 中的一段
+struct Fragment {
+    PacketBuffer* buf;
+    uint32_t offset;
+    uint32_t size;
+
+    char* data() const { return buf->base + offset; }
+
+    void retain() const {
+        buf->check_owner();
+        ++buf->refs;
+    }
+
+    void release() const {
+        buf->check_owner();
+        if (--buf->refs == 0) buf->free_fn(buf);
+    }
+};
+
+class ForeignPacket;
+
+/**
+ * 分散/聚集的 Packet：由若干分片组成，每个分片各自持有一个 buffer 的引用
+ * 拼装响应（缓存的头部 + 计算出的 body + 尾部）只是追加分片，不做 memcpy；
+ * slice 可以跨越分片边界；to_iovec 直接交给 writev
+ * 少量分片存放在对象内部，超出后才在堆上扩展
+ *
+ * data() 需要连续内存：多分片时会先 linearize()，复制成一个分片
+ */
 class Packet {
 private:
-    std::shared_ptr<char[]> data_;
-    
-    size_t offset_;
+    static constexpr uint16_t kInlineFragments = 4;
+
+    Fragment inline_[kInlineFragments];
+    Fragment* heap_;          // 分片数超过 kInlineFragments 后的扩展数组
+    uint16_t nr_frags_;
+    uint16_t capacity_;
     size_t size_;
 
+    friend class ForeignPacket;
+
+    Fragment* frags() { return heap_ ? heap_ : inline_; }
+    const Fragment* frags() const { return heap_ ? heap_ : inline_; }
+
+    void reserve(size_t n) {
+        if (n <= capacity_) return;
+        size_t cap = std::max<size_t>(n, size_t(capacity_) * 2);
+        Fragment* bigger = new Fragment[cap];
+        std::memcpy(static_cast<void*>(bigger), frags(), sizeof(Fragment) * nr_frags_);
+        delete[] heap_;
+        heap_ = bigger;
+        capacity_ = static_cast<uint16_t>(cap);
+    }
+
+    // 只搬运分片，不改引用计数
+    void push_back_frag(const Fragment& f) {
+        reserve(size_t(nr_frags_) + 1);
+        frags()[nr_frags_++] = f;
+        size_ += f.size;
+    }
+
+    void push_front_frag(const Fragment& f) {
+        reserve(size_t(nr_frags_) + 1);
+        Fragment* fs = frags();
+        std::memmove(static_cast<void*>(fs + 1), fs, sizeof(Fragment) * nr_frags_);
+        fs[0] = f;
+        ++nr_frags_;
+        size_ += f.size;
+    }
+
+    void release_all() {
+        if (nr_frags_ == 0) return;
+        if (nr_frags_ == 1 && !heap_) {
+            inline_[0].release();
+            nr_frags_ = 0;
+            size_ = 0;
+            return;
+        }
+        const Fragment* fs = frags();
+        for (uint16_t i = 0; i < nr_frags_; ++i) fs[i].release();
+        nr_frags_ = 0;
+        size_ = 0;
+    }
+
+    void steal(Packet& other) {
+        if (other.heap_) {
+            heap_ = other.heap_;
+            capacity_ = other.capacity_;
+            other.heap_ = nullptr;
+            other.capacity_ = kInlineFragments;
+        } else {
+            std::memcpy(static_cast<void*>(inline_), other.inline_, sizeof(Fragment) * other.nr_frags_);
+        }
+        nr_frags_ = other.nr_frags_;
+        size_ = other.size_;
+        other.nr_frags_ = 0;
+        other.size_ = 0;
+    }
+
 public:
-    Packet() : data_(nullptr), offset_(0), size_(0) {}
+    Packet() : heap_(nullptr), nr_frags_(0), capacity_(kInlineFragments), size_(0) {}
 
-    explicit Packet(size_t size) : offset_(0), size_(size) {
+    explicit Packet(size_t size) : Packet() {
         if (size > 0) {
-            data_ = std::shared_ptr<char[]>(new char[size]);
+            push_back_frag({packet_detail::allocate_buffer(size), 0, static_cast<uint32_t>(size)});
         }
     }
 
     Packet(const char* data, size_t size) : Packet(size) {
         if (size_ > 0 && data) {
-            std::memcpy(data_.get(), data, size);
+            std::memcpy(inline_[0].data(), data, size);
+        }
+    }
+
+    // 拷贝等同于 share()：同一 shard 内只是普通整数 +1
+    Packet(const Packet& other) : Packet() {
+        if (other.nr_frags_ == 1) {  // 最常见的单分片：不走通用循环
+            inline_[0] = other.frags()[0];
+            inline_[0].retain();
+            nr_frags_ = 1;
+            size_ = other.size_;
+            return;
+        }
+        reserve(other.nr_frags_);
+        const Fragment* fs = other.frags();
+        for (uint16_t i = 0; i < other.nr_frags_; ++i) {
+            fs[i].retain();
+            push_back_frag(fs[i]);
+        }
+    }
+
+    Packet(Packet&& other) noexcept : Packet() {
+        steal(other);
+    }
+
+    Packet& operator=(const Packet& other) {
+        if (this != &other) {
+            Packet tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    Packet& operator=(Packet&& other) noexcept {
+        if (this != &other) {
+            release_all();
+            delete[] heap_;
+            heap_ = nullptr;
+            capacity_ = kInlineFragments;
+            steal(other);
         }
+        return *this;
+    }
+
+    ~Packet() {
+        release_all();
+        if (heap_) delete[] heap_;
     }
 
     static Packet from_string(const std::string& str) {
         return Packet(str.data(), str.size());
     }
 
+    // 引用一段已有 buffer 的内存（例如 NetBuffer），计数 +1，不复制
+    static Packet wrap(PacketBuffer* buf, size_t offset, size_t size) {
+        Packet p;
+        if (size == 0) return p;
+        Fragment f{buf, static_cast<uint32_t>(offset), static_cast<uint32_t>(size)};
+        f.retain();
+        p.push_back_frag(f);
+        return p;
+    }
+
     // 返回一个新的 Packet，指向同一块内存，引用计数 +1
     Packet share() const {
-        Packet other;
-        other.data_ = data_; // shared_ptr 赋值，ref_count++
-        other.offset_ = offset_;
-        other.size_ = size_;
-        return other;
+        return Packet(*this);
     }
 
-    // 返回一个新的 Packet，指向同一块内存，但只看一部分
+    // 返回一个新的 Packet，指向同一块内存，但只看一部分（可以跨越分片）
     Packet slice(size_t start, size_t length) const {
         if (start >= size_) return Packet(); // 越界返回空
         if (start + length > size_) length = size_ - start; // 截断
 
         Packet other;
-        other.data_ = data_; // 共享内存
-        other.offset_ = offset_ + start; // 调整视图偏移
-        other.size_ = length; // 调整视图大小
+        const Fragment* fs = frags();
+        if (nr_frags_ == 1) {
+            fs[0].retain(); // 共享内存
+            other.inline_[0] = {fs[0].buf, fs[0].offset + static_cast<uint32_t>(start), static_cast<uint32_t>(length)};
+            other.nr_frags_ = 1;
+            other.size_ = length;
+            return other;
+        }
+        for (uint16_t i = 0; i < nr_frags_ && length > 0; ++i) {
+            if (start >= fs[i].size) {
+                start -= fs[i].size;
+                continue;
+            }
+            uint32_t n = static_cast<uint32_t>(std::min<size_t>(fs[i].size - start, length));
+            fs[i].retain(); // 共享内存
+            other.push_back_frag({fs[i].buf, fs[i].offset + static_cast<uint32_t>(start), n});
+            start = 0;
+            length -= n;
+        }
         return other;
     }
 
@@ -55,25 +303,172 @@ public:
         return slice(n, size_ - n);
     }
 
-    char* data() { 
-        if (!data_) return nullptr;
-        return data_.get() + offset_; 
+    // 把另一个 Packet 的分片接到尾部/头部；传右值时直接转移引用，不改计数
+    // 追加的分片与尾部分片在同一个 buffer 里首尾相接时（例如同一个接收缓冲区先后两次读到的数据）
+    // 合并成一个分片，释放多出来的那个引用，之后 data() 不必再复制
+    void append(Packet&& other) {
+        if (other.nr_frags_ == 0) return;
+        reserve(size_t(nr_frags_) + other.nr_frags_);
+        const Fragment* fs = other.frags();
+        for (uint16_t i = 0; i < other.nr_frags_; ++i) {
+            if (nr_frags_ > 0) {
+                Fragment& last = frags()[nr_frags_ - 1];
+                if (last.buf == fs[i].buf && last.offset + last.size == fs[i].offset) {
+                    last.size += fs[i].size;
+                    size_ += fs[i].size;
+                    fs[i].release();
+                    continue;
+                }
+            }
+            push_back_frag(fs[i]);
+        }
+        other.nr_frags_ = 0;
+        other.size_ = 0;
+    }
+
+    void append(const Packet& other) {
+        append(other.share());
+    }
+
+    void prepend(Packet&& other) {
+        if (other.nr_frags_ == 0) return;
+        reserve(size_t(nr_frags_) + other.nr_frags_);
+        const Fragment* fs = other.frags();
+        for (uint16_t i = other.nr_frags_; i > 0; --i) push_front_frag(fs[i - 1]);
+        other.nr_frags_ = 0;
+        other.size_ = 0;
+    }
+
+    void prepend(const Packet& other) {
+        prepend(other.share());
+    }
+
+    // 把多个分片复制成一个连续分片；单分片时什么也不做
+    // 直接就地替换分片，不经过临时 Packet：默认构造不初始化 inline_（热路径上省掉清零），
+    // 经由 move 赋值搬运未初始化的数组会触发 -Wmaybe-uninitialized
+    void linearize() {
+        if (nr_frags_ <= 1) return;
+        Fragment flat{packet_detail::allocate_buffer(size_), 0, static_cast<uint32_t>(size_)};
+        char* dest = flat.data();
+        const Fragment* fs = frags();
+        for (uint16_t i = 0; i < nr_frags_; ++i) {
+            std::memcpy(dest, fs[i].data(), fs[i].size);
+            dest += fs[i].size;
+        }
+        release_all();
+        push_back_frag(flat);
     }
-    
-    const char* data() const { 
-        if (!data_) return nullptr;
-        return data_.get() + offset_; 
+
+    // 多分片时会 linearize()，改变存储方式，所以只对非 const 的 Packet 提供；
+    // const 的 Packet 用 fragment() / to_iovec() 按分片访问
+    char* data() {
+        if (nr_frags_ == 0) return nullptr;
+        linearize();
+        return frags()[0].data();
     }
 
     size_t size() const { return size_; }
 
+    size_t nr_frags() const { return nr_frags_; }
+
+    const Fragment& fragment(size_t i) const { return frags()[i]; }
+
+    // 填充 iovec 视图，返回填入的个数（最多 max 个）
+    size_t to_iovec(struct iovec* iov, size_t max) const {
+        size_t n = std::min<size_t>(nr_frags_, max);
+        const Fragment* fs = frags();
+        for (size_t i = 0; i < n; ++i) {
+            iov[i].iov_base = fs[i].data();
+            iov[i].iov_len = fs[i].size;
+        }
+        return n;
+    }
+
     std::string to_string() const {
-        if (!data_) return "";
-        return std::string(data(), size_);
+        std::string s;
+        s.reserve(size_);
+        const Fragment* fs = frags();
+        for (uint16_t i = 0; i < nr_frags_; ++i) s.append(fs[i].data(), fs[i].size);
+        return s;
     }
 
-    // 调试用：查看引用计数
+    // 调试用：查看（第一个分片的）引用计数
     long use_count() const {
-        return data_.use_count();
+        return nr_frags_ ? static_cast<long>(frags()[0].buf->refs) : 0;
+    }
+};
+
+/**
+ * 跨 shard 移交 Packet 的唯一通道
+ * 在源 shard 上构造：所有分片的 buffer 都只被这个 Packet 引用时直接摘下移交，
+ * 否则（还被本 shard 的其他 Packet 共享）复制成一份独占的连续 buffer，源 shard 的计数不受影响
+ * 在目标 shard 上调用 adopt()，buffer 改记到目标 shard 名下，之后就是普通的本地 Packet
+ * 内存最终在目标 shard 释放，由 Poolable 的跨线程归还送回源 shard 的池
+ *
+ * 只能移动；经 Engine::submit_to（std::function 要求可拷贝）传递时用 shared_ptr 包一层
+ */
+class ForeignPacket {
+private:
+    Packet packet_;
+
+    void set_owner(const void* owner) {
+        Fragment* fs = packet_.frags();
+        for (uint16_t i = 0; i < packet_.nr_frags_; ++i) fs[i].buf->owner = owner;
+    }
+
+public:
+    ForeignPacket() = default;
+
+    explicit ForeignPacket(Packet&& p) {
+        bool shared = false;
+        const Fragment* fs = p.frags();
+        for (uint16_t i = 0; i < p.nr_frags_; ++i) {
+            if (fs[i].buf->refs > 1) shared = true;
+        }
+        if (shared) {
+            packet_ = Packet(p.size());
+            char* dest = packet_.inline_[0].data();
+            for (uint16_t i = 0; i < p.nr_frags_; ++i) {
+                std::memcpy(dest, fs[i].data(), fs[i].size);
+                dest += fs[i].size;
+            }
+            p = Packet();
+        } else {
+            packet_ = std::move(p);
+        }
+        set_owner(nullptr);
+    }
+
+    ForeignPacket(ForeignPacket&& other) noexcept = default;
+    ForeignPacket& operator=(ForeignPacket&& other) noexcept {
+        if (this != &other) {
+            reset();
+            packet_ = std::move(other.packet_);
+        }
+        return *this;
+    }
+    ForeignPacket(const ForeignPacket&) = delete;
+    ForeignPacket& operator=(const ForeignPacket&) = delete;
+
+    ~ForeignPacket() {
+        reset();
+    }
+
+    // 在目标 shard 上取出 Packet
+    Packet adopt() {
+        for (size_t i = 0; i < packet_.nr_frags(); ++i) {
+            assert(packet_.fragment(i).buf->owner == nullptr && packet_.fragment(i).buf->refs == 1);
+        }
+        set_owner(PacketBuffer::local_owner());
+        return std::move(packet_);
+    }
+
+    size_t size() const { return packet_.size(); }
+
+private:
+    // 没有被 adopt 就丢弃：每个 buffer 只有这一个引用，可以在任意线程直接回收
+    void reset() {
+        set_owner(PacketBuffer::local_owner());
+        packet_ = Packet();
     }
-};
\ No newline at end of file
+};
@@ -1,9 +1,187 @@
 #pragma once
 #include <vector>
+#include <atomic>
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <thread>
+#include <mutex>
 #include <new>
+#include <string>
+#include <cstdlib>
+#include <typeinfo>
+#include <cxxabi.h>
+#include <sys/mman.h>
+#include "Numa.h"
+
+constexpr size_t kHugePageSize=2*1024*1024;
+
+enum class HugePageMode{
+    kOff,          //普通 4KB 页
+    kTransparent,  //madvise(MADV_HUGEPAGE)，由内核 THP 尽量合并成大页
+    kHugeTlb,      //MAP_HUGETLB 显式大页（需预留 vm.nr_hugepages），失败自动回退到 THP
+};
+
+//对象池的全局配置，需在 Engine::run 之前设置好
+struct PoolConfig{
+    //每个池最多保留多少个全空 chunk（高水位），超出的由 Reactor 定时器逐步 munmap
+    static inline size_t max_free_chunks=2;
+    //Reactor 执行回收的周期，<=0 表示关闭
+    static inline int trim_interval_ms=1000;
+    //chunk 是否使用 2MB 大页，减少大量连接/NetBuffer 下的 TLB miss 和缺页开销；
+    //开启后每个池类型的 chunk 至少 2MB。各类型在第一次分配时读取它定下 chunk 大小，之后再改不影响已用过的类型
+    static inline HugePageMode huge_pages=HugePageMode::kOff;
+};
+
+//chunk 的来源：直接向内核要按 bytes（2 的幂）对齐的匿名内存，
+//这样 trim 时可以 munmap 整块归还，而不是留在 malloc 的空闲链表里
+class ChunkSource{
+private:
+    //MAP_HUGETLB 失败过一次（大页池耗尽/未配置）后不再尝试，避免每次都多一次失败的系统调用
+    static inline std::atomic<bool> hugetlb_unavailable_{false};
+
+    static void* map_aligned(size_t bytes,int extra_flags){
+        //多映射一倍再裁掉首尾，得到 bytes 对齐的区域
+        size_t len=bytes*2;
+        void* raw=::mmap(nullptr,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|extra_flags,-1,0);
+        if(raw==MAP_FAILED) return nullptr;
+
+        uintptr_t start=reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned=(start+bytes-1)&~(uintptr_t)(bytes-1);
+        if(aligned>start) ::munmap(raw,aligned-start);
+        size_t tail=(start+len)-(aligned+bytes);
+        if(tail>0) ::munmap(reinterpret_cast<void*>(aligned+bytes),tail);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    static void* map_hugetlb(size_t bytes){
+        if(hugetlb_unavailable_.load(std::memory_order_relaxed)) return nullptr;
+        //hugetlbfs 映射天然 2MB 对齐；更大的 chunk 才需要多映射再裁剪
+        void* p=nullptr;
+        if(bytes==kHugePageSize){
+            p=::mmap(nullptr,bytes,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+            if(p==MAP_FAILED) p=nullptr;
+        }else{
+            p=map_aligned(bytes,MAP_HUGETLB);
+        }
+        if(!p) hugetlb_unavailable_.store(true,std::memory_order_relaxed);
+        return p;
+    }
+
+public:
+    static void* map(size_t bytes){
+        //不足一个大页的 chunk（类型在关闭大页时定下的大小）始终用普通页
+        HugePageMode mode=bytes<kHugePageSize?HugePageMode::kOff:PoolConfig::huge_pages;
+        if(mode==HugePageMode::kHugeTlb){
+            if(void* p=map_hugetlb(bytes)){
+                numa::bind_local(p,bytes);
+                return p;
+            }
+            mode=HugePageMode::kTransparent;
+        }
+
+        void* p=map_aligned(bytes,0);
+        if(!p) throw std::bad_alloc();
+        //首次触碰之前绑定到本 shard 的 NUMA 节点，之后缺页分配的物理页都落在本地
+        numa::bind_local(p,bytes);
+        if(mode==HugePageMode::kTransparent){
+            ::madvise(p,bytes,MADV_HUGEPAGE);
+        }
+        return p;
+    }
+
+    static void unmap(void* p,size_t bytes){
+        ::munmap(p,bytes);
+    }
+
+    static bool hugetlb_available(){return !hugetlb_unavailable_.load(std::memory_order_relaxed);}
+};
+
+//单个对象池（某个类型在某个 shard 上）的快照，用于定位泄漏和估算池的规模
+struct PoolStats{
+    std::string type_name;
+    size_t object_size=0;
+    size_t live=0;          //已分配未归还（含已在别的 shard 释放、尚未被收回的）
+    size_t free=0;          //已映射 chunk 中的空闲节点
+    size_t chunks=0;
+    size_t chunk_bytes=0;
+    size_t peak_live=0;     //live 的历史最高值
+    size_t remote_chunks=0; //首页不在本 shard NUMA 节点上的 chunk 数，正常应为 0
+};
+
+//每个线程的所有对象池都登记在这里，Reactor::run 每轮通过它统一处理跨线程归还
+class PoolBase{
+public:
+    virtual ~PoolBase()=default;
+    virtual PoolStats stats() const=0;
+    //把别的线程归还给本池的节点收回本地 free list，并把本线程攒着的、要还给别人的批次发出去
+    virtual void drain_remote_frees()=0;
+    //把超出水位的全空 chunk 归还给 OS
+    virtual void trim()=0;
+};
+
+//Reactor::run 每轮都调用 drain_remote_frees，空闲的一轮只检查两个计数，不遍历所有池：
+//  incoming_  别的线程给本线程的某个池推过节点后置位
+//  outgoing_  本线程有几个池攒着尚未发出的批次（不满 kRemoteBatch 个）
+//不满一批的节点只在本线程的 Reactor 循环或线程退出时发出；停止循环的线程最多压着每个池 31 个节点
+class PoolRegistry{
+private:
+    std::vector<PoolBase*> pools_;
+    std::atomic<bool> incoming_{false};
+    size_t outgoing_=0;
+
+public:
+    //注册表在堆上且不释放：孤儿池（见 Poolable::ThreadLocalPool::retire）的归还方线程退出后仍会通知它
+    static PoolRegistry& local(){
+        static thread_local PoolRegistry* registry=new PoolRegistry();
+        return *registry;
+    }
+
+    void add(PoolBase* pool){pools_.push_back(pool);}
+    void remove(PoolBase* pool){
+        pools_.erase(std::remove(pools_.begin(),pools_.end(),pool),pools_.end());
+    }
+
+    //由归还方在推送节点之后调用，可以来自任意线程
+    void notify_incoming(){incoming_.store(true,std::memory_order_release);}
+
+    void batch_started(){++outgoing_;}
+    void batch_flushed(){--outgoing_;}
+
+    void drain_remote_frees(){
+        if(outgoing_==0&&!incoming_.load(std::memory_order_relaxed)) return;
+        //先清标志再遍历：遍历期间新到的节点会重新置位，下一轮再收
+        incoming_.exchange(false,std::memory_order_acquire);
+        for(PoolBase* pool:pools_){
+            pool->drain_remote_frees();
+        }
+    }
+
+    void trim(){
+        for(PoolBase* pool:pools_){
+            pool->trim();
+        }
+    }
+
+    std::vector<PoolStats> stats() const{
+        std::vector<PoolStats> result;
+        result.reserve(pools_.size());
+        for(PoolBase* pool:pools_){
+            result.push_back(pool->stats());
+        }
+        return result;
+    }
+};
+
+inline std::string demangle_type_name(const char* mangled){
+    int status=0;
+    char* name=abi::__cxa_demangle(mangled,nullptr,nullptr,&status);
+    if(status!=0||!name) return mangled;
+    std::string result(name);
+    std::free(name);
+    return result;
+}
 
 template <typename T,size_t ChunkSize=256>
 class Poolable
@@ -30,59 +208,325 @@ private:
         alignas(alignof(T)) unsigned char storage[sizeof(T)];
     };
 
-    class ThreadLocalPool{
+    class ThreadLocalPool;
+
+    //chunk 头部：记录这块内存属于哪个线程的池，以及本 chunk 自己的空闲链表和占用情况
+    //chunk 按自身大小（2 的幂）对齐，任意节点地址抹掉低位即可找到头部，O(1) 判定归属
+    //每个 chunk 单独维护 free list，才能知道它何时完全空闲、可以整块还给 OS
+    struct ChunkHeader
+    {
+        ThreadLocalPool* owner;
+        Node* free_list;
+        size_t free_count;     //空闲节点数（含尚未切分的部分）
+        size_t carved;         //已切分出去的节点数，其余部分从未被触碰，不占物理页
+        size_t capacity;       //本 chunk 的节点总数
+        ChunkHeader* prev;
+        ChunkHeader* next;
+        int list;
+    };
+
+    enum { kFullList=0, kPartialList=1, kEmptyList=2 };
+
+    struct ChunkList
+    {
+        ChunkHeader* head=nullptr;
+        size_t size=0;
+
+        void push_front(ChunkHeader* c){
+            c->prev=nullptr;
+            c->next=head;
+            if(head) head->prev=c;
+            head=c;
+            ++size;
+        }
+        void unlink(ChunkHeader* c){
+            if(c->prev) c->prev->next=c->next;
+            else head=c->next;
+            if(c->next) c->next->prev=c->prev;
+            c->prev=c->next=nullptr;
+            --size;
+        }
+    };
+
+    static constexpr size_t round_up_pow2(size_t n){
+        size_t p=1;
+        while(p<n) p<<=1;
+        return p;
+    }
+
+    static constexpr size_t kPageSize=4096;
+    static constexpr size_t kHeaderSize=(sizeof(ChunkHeader)+alignof(Node)-1)/alignof(Node)*alignof(Node);
+    //不开大页时的 chunk：放得下 ChunkSize 个节点的 2 的幂，小类型每个线程只占几 KB 到几十 KB
+    static constexpr size_t kSmallChunkBytes=std::max(kPageSize,round_up_pow2(kHeaderSize+sizeof(Node)*ChunkSize));
+    //跨线程归还攒够这么多个再一次性推给 owner，摊薄 CAS 和 cache line 争用
+    static constexpr size_t kRemoteBatch=32;
+
+    //chunk 大小在本类型第一次分配时按 PoolConfig::huge_pages 定下，此后所有线程都用它（header_of 依赖统一的对齐）：
+    //开大页时至少一个大页（2MB），按自身大小对齐后整块都能落在大页上；否则用 kSmallChunkBytes
+    static size_t chunk_bytes(){
+        static const size_t bytes=PoolConfig::huge_pages==HugePageMode::kOff
+            ?kSmallChunkBytes:std::max(kHugePageSize,kSmallChunkBytes);
+        return bytes;
+    }
+
+    //向上取整到 2 的幂后多出来的空间也切成节点，不浪费
+    static size_t nodes_per_chunk(){
+        return (chunk_bytes()-kHeaderSize)/sizeof(Node);
+    }
+
+    static ChunkHeader* header_of(void* ptr){
+        return reinterpret_cast<ChunkHeader*>(reinterpret_cast<uintptr_t>(ptr)&~(uintptr_t)(chunk_bytes()-1));
+    }
+
+    class ThreadLocalPool:public PoolBase{
     private:
-        Node* head_=nullptr;
-        std::vector<Node*> chunks_;
+        //partial_ 优先分配（把对象往少数 chunk 上集中，让其余 chunk 有机会变空）
+        ChunkList full_;
+        ChunkList partial_;
+        ChunkList empty_;
         const std::thread::id thread_id_;
+        PoolRegistry* const registry_;
+
+        size_t live_=0;
+        size_t peak_live_=0;
+
+        //别的线程归还给本池的节点：多生产者（Treiber 栈）、单消费者（owner 一次 exchange 全部取走）
+        alignas(64) std::atomic<Node*> remote_head_{nullptr};
+        //owner 线程已退出（见 retire）：之后推过来的节点由归还方自己在 orphan_mutex 下收回
+        std::atomic<bool> orphaned_{false};
+
+        //本线程释放的、属于其他线程的节点，按 owner 攒成一批
+        ThreadLocalPool* batch_owner_=nullptr;
+        Node* batch_head_=nullptr;
+        Node* batch_tail_=nullptr;
+        size_t batch_len_=0;
+
+        ChunkList& list_of(int which){
+            return which==kFullList?full_:(which==kPartialList?partial_:empty_);
+        }
+
+        void move_to(ChunkHeader* c,int which){
+            list_of(c->list).unlink(c);
+            c->list=which;
+            list_of(which).push_front(c);
+        }
 
         void allocate_chunk(){
-            //一次性分配ChunkSize节点连续内存
-            Node* chunk=static_cast<Node*>(::operator new(sizeof(Node)*ChunkSize));
-            chunks_.push_back(chunk);
-
-            //大内存切分多个Node，串联成侵入式链表
-            //LIFO的Cache局部性，从后往前串联
-            for(size_t i=0;i<ChunkSize-1;++i){
-                chunk[i].next=&chunk[i+1];
+            //节点按需切分（carved），新 chunk 不会一次性触碰所有页
+            ChunkHeader* header=static_cast<ChunkHeader*>(ChunkSource::map(chunk_bytes()));
+            header->owner=this;
+            header->free_list=nullptr;
+            header->capacity=nodes_per_chunk();
+            header->free_count=header->capacity;
+            header->carved=0;
+            header->list=kEmptyList;
+            empty_.push_front(header);
+        }
+
+        void release_chunk(ChunkHeader* c){
+            list_of(c->list).unlink(c);
+            ChunkSource::unmap(c,chunk_bytes());
+        }
+
+        static Node* take_node(ChunkHeader* c){
+            --c->free_count;
+            if(c->free_list){
+                //LIFO的Cache局部性：最近归还的节点最先复用
+                Node* node=c->free_list;
+                c->free_list=node->next;
+                return node;
+            }
+            Node* base=reinterpret_cast<Node*>(reinterpret_cast<unsigned char*>(c)+kHeaderSize);
+            return &base[c->carved++];
+        }
+
+        void free_local(Node* node){
+            --live_;
+            ChunkHeader* c=header_of(node);
+            node->next=c->free_list;
+            c->free_list=node;
+            ++c->free_count;
+
+            if(c->free_count==c->capacity){
+                move_to(c,kEmptyList);
+            }else if(c->list==kFullList){
+                move_to(c,kPartialList);
+            }
+        }
+
+        //接收一整串别的线程归还的节点（由归还方调用）
+        //seq_cst：与 retire 中 orphaned_ 的写入配对，二者至少有一方看到对方，节点不会无人收回
+        void push_remote(Node* first,Node* last){
+            Node* old=remote_head_.load(std::memory_order_relaxed);
+            do{
+                last->next=old;
+            }while(!remote_head_.compare_exchange_weak(old,first,std::memory_order_seq_cst,std::memory_order_relaxed));
+        }
+
+        void flush_batch(){
+            if(!batch_head_) return;
+            ThreadLocalPool* owner=batch_owner_;
+            owner->push_remote(batch_head_,batch_tail_);
+            owner->registry_->notify_incoming();
+            batch_owner_=nullptr;
+            batch_head_=batch_tail_=nullptr;
+            batch_len_=0;
+            registry_->batch_flushed();
+            if(owner->orphaned_.load(std::memory_order_seq_cst)) owner->drain_orphan();
+        }
+
+        static std::mutex& orphan_mutex(){
+            static std::mutex mu;
+            return mu;
+        }
+
+        //孤儿池：把已推过来的节点收回各自的 chunk，变空的 chunk 立即归还给 OS
+        void drain_orphan(){
+            std::lock_guard<std::mutex> lock(orphan_mutex());
+            Node* node=remote_head_.exchange(nullptr,std::memory_order_seq_cst);
+            while(node){
+                Node* next=node->next;
+                free_local(node);
+                node=next;
             }
-            chunk[ChunkSize-1].next=head_;
-            head_=chunk;
+            while(empty_.head) release_chunk(empty_.head);
         }
-        
+
+        void deallocate_remote(ThreadLocalPool* owner,Node* node){
+            if(owner!=batch_owner_){
+                flush_batch();
+                batch_owner_=owner;
+            }
+            if(!batch_head_) registry_->batch_started();
+            node->next=batch_head_;
+            batch_head_=node;
+            if(!batch_tail_) batch_tail_=node;
+            if(++batch_len_>=kRemoteBatch){
+                flush_batch();
+            }
+        }
+
+        void reclaim_remote(){
+            if(remote_head_.load(std::memory_order_relaxed)==nullptr) return;
+            Node* node=remote_head_.exchange(nullptr,std::memory_order_acquire);
+            while(node){
+                Node* next=node->next;
+                free_local(node);
+                node=next;
+            }
+        }
+
     public:
-        ThreadLocalPool():thread_id_(std::this_thread::get_id()){
-            allocate_chunk();
+        ThreadLocalPool():thread_id_(std::this_thread::get_id()),registry_(&PoolRegistry::local()){
+            //不预先分配 chunk：只做跨线程归还的线程用不到本地 chunk
+            registry_->add(this);
         }
         ~ThreadLocalPool(){
-            for(Node* chunk:chunks_){
-                ::operator delete(chunk);
+            while(full_.head) release_chunk(full_.head);
+            while(partial_.head) release_chunk(partial_.head);
+            while(empty_.head) release_chunk(empty_.head);
+        }
+
+        //owner 线程退出时调用（见 PoolHolder）
+        //其他线程手里可能还有本池分配的对象，chunk 头中的 owner 指向这个池，所以有过分配的池不销毁：
+        //标记为孤儿，存活对象所在的 chunk 原样保留，之后的远端归还由归还方调用 drain_orphan 收回，
+        //chunk 变空时归还给 OS；池对象本身留在进程里（几百字节），归还方随时可能还在访问它
+        void retire(){
+            flush_batch();
+            registry_->remove(this);
+            if(peak_live_==0){
+                //从未分配过：没有 chunk 头指向它，可以直接销毁
+                delete this;
+                return;
             }
+            orphaned_.store(true,std::memory_order_seq_cst);
+            drain_orphan();
         }
 
         void* allocate(){
             assert(std::this_thread::get_id()==thread_id_ && "Strict Shared-Nothing: Cross-thread allocation forbidden!");
-            if(head_==nullptr){
-                allocate_chunk();
+            ChunkHeader* c=partial_.head;
+            if(c==nullptr){
+                reclaim_remote();
+                c=partial_.head;
+            }
+            if(c==nullptr){
+                if(empty_.head==nullptr){
+                    allocate_chunk();
+                }
+                c=empty_.head;
+                move_to(c,kPartialList);
             }
 
-            Node* node=head_;
-            head_=head_->next;
+            Node* node=take_node(c);
+            if(c->free_count==0){
+                move_to(c,kFullList);
+            }
+            if(++live_>peak_live_) peak_live_=live_;
             return node;
         }
 
         void deallocate(void* ptr){
-            assert(std::this_thread::get_id()==thread_id_ && "Strict Shared-Nothing: Cross-thread allocation forbidden!");
-
             Node* node=static_cast<Node*>(ptr);
-            node->next=head_;
-            head_=node;
+            ThreadLocalPool* owner=header_of(ptr)->owner;
+
+            //在别的 shard 上创建的对象（例如经 submit_to 交接过来的 NetBuffer）：
+            //不能挂到本线程的 free list，交还给 owner，由 owner 在 Reactor::run 中收回
+            if(owner!=this){
+                deallocate_remote(owner,node);
+                return;
+            }
+
+            free_local(node);
+        }
+
+        PoolStats stats() const override{
+            PoolStats st;
+            st.type_name=demangle_type_name(typeid(T).name());
+            st.object_size=sizeof(T);
+            st.live=live_;
+            st.chunks=full_.size+partial_.size+empty_.size;
+            st.chunk_bytes=chunk_bytes();
+            st.free=st.chunks*nodes_per_chunk()-live_;
+            st.peak_live=peak_live_;
+            if(numa::node_count()>1){
+                int local=numa::local_node();
+                for(const ChunkList* list:{&full_,&partial_,&empty_}){
+                    for(ChunkHeader* c=list->head;c;c=c->next){
+                        int node=numa::node_of(c);
+                        if(node>=0&&node!=local) ++st.remote_chunks;
+                    }
+                }
+            }
+            return st;
+        }
+
+        void drain_remote_frees() override{
+            flush_batch();
+            reclaim_remote();
+        }
+
+        //衰减式回收：每次只归还超出水位部分的一半（向上取整），
+        //突发流量过后 RSS 逐步回落，又不会在负载抖动时反复 mmap/munmap
+        void trim() override{
+            size_t keep=PoolConfig::max_free_chunks;
+            if(empty_.size<=keep) return;
+            size_t to_release=(empty_.size-keep+1)/2;
+            while(to_release-- > 0 && empty_.head){
+                release_chunk(empty_.head);
+            }
         }
     };
 
+    //池对象放在堆上，线程退出时由 retire 决定销毁还是留作孤儿，不随 thread_local 存储一起释放
+    struct PoolHolder{
+        ThreadLocalPool* pool=new ThreadLocalPool();
+        ~PoolHolder(){pool->retire();}
+    };
+
     static ThreadLocalPool& get_pool(){
-        static thread_local ThreadLocalPool pool;
-        return pool;
+        static thread_local PoolHolder holder;
+        return *holder.pool;
     }
-    
-};
\ No newline at end of file
+
+};
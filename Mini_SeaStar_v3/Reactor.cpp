@@ -1,5 +1,8 @@
 #include "Reactor.h"
 #include "Future.h"
+#include "Poolable.h"
+#include "Memory.h"
+#include "BufferLimits.h"
 #include <stdexcept>
 #include <iostream>
 #include <unistd.h>
@@ -41,9 +44,19 @@ Reactor::Reactor() {
 
     if (instance_ != nullptr) throw std::runtime_error("Reactor already exists!");
     instance_ = this;
+
+    schedule_pool_trim();
 }
 
 Reactor::~Reactor() {
+    // 先把 handlers 挪出来再析构：handler 持有的 TcpConnection 析构时会回调 remove()
+    auto handlers_to_drop = std::move(handlers);
+    handlers.clear();
+    handlers_to_drop.clear();
+    pending_tasks.clear();
+    iteration_end_hooks_.clear();
+    timer_callbacks_.clear();
+
     close(notify_fd);
     close(epoll_fd);
     close(timer_fd);
@@ -90,20 +103,55 @@ void Reactor::schedule(std::function<void()> task) {
     pending_tasks.push_back(std::move(task));
 }
 
-void Reactor::run_after(int delay_ms, std::function<void()> callback) {
+TimerId Reactor::run_after(int delay_ms, std::function<void()> callback) {
     auto expire_time = Clock::now() + std::chrono::milliseconds(delay_ms);
-    run_at(expire_time, std::move(callback));
+    return run_at(expire_time, std::move(callback));
 }
 
-void Reactor::run_at(TimePoint timestamp, std::function<void()> callback) {
+TimerId Reactor::run_at(TimePoint timestamp, std::function<void()> callback) {
     bool earliest_changed = false;
     if (timers_.empty() || timestamp < timers_.top().expire_time) {
         earliest_changed = true;
     }
-    timers_.push({timestamp, std::move(callback), 0});
+    TimerId id = next_timer_id_++;
+    timers_.push({timestamp, id});
+    timer_callbacks_.emplace(id, std::move(callback));
     if (earliest_changed) {
         reset_timer_fd();
     }
+    return id;
+}
+
+bool Reactor::cancel_timer(TimerId id) {
+    if (timer_callbacks_.erase(id) == 0) return false;
+
+    // 大量超时在到期前被取消（典型的 with_timeout 场景）时，
+    // 堆里的残留条目会越积越多，超过一定比例就重建一次
+    if (timers_.size() > 64 && timers_.size() > 2 * timer_callbacks_.size()) {
+        compact_timers();
+    }
+    return true;
+}
+
+void Reactor::compact_timers() {
+    std::vector<TimerTask> live;
+    live.reserve(timer_callbacks_.size());
+    while (!timers_.empty()) {
+        if (timer_callbacks_.count(timers_.top().id)) {
+            live.push_back(timers_.top());
+        }
+        timers_.pop();
+    }
+    for (auto& t : live) timers_.push(t);
+}
+
+// 周期性地把各对象池中超出水位的全空 chunk 还给 OS，让 RSS 跟随负载而不是历史峰值
+void Reactor::schedule_pool_trim() {
+    if (PoolConfig::trim_interval_ms <= 0) return;
+    run_after(PoolConfig::trim_interval_ms, [this]() {
+        PoolRegistry::local().trim();
+        schedule_pool_trim();
+    });
 }
 
 void Reactor::reset_timer_fd() {
@@ -131,7 +179,12 @@ void Reactor::handle_timer_events() {
     while (!timers_.empty() && timers_.top().expire_time <= now) {
         TimerTask task = timers_.top();
         timers_.pop();
-        if (task.callback) task.callback();
+
+        auto it = timer_callbacks_.find(task.id);
+        if (it == timer_callbacks_.end()) continue;  // 已被取消
+        auto callback = std::move(it->second);
+        timer_callbacks_.erase(it);
+        if (callback) callback();
     }
     if (!timers_.empty()) {
         reset_timer_fd();
@@ -147,9 +200,13 @@ Future<void> Reactor::sleep(int seconds) {
 }
 
 void Reactor::submit_task(std::function<void()> task) {
+    while (submit_lock_.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
     while(!cross_core_queue_.push(std::move(task))){
         std::this_thread::yield();
     }
+    submit_lock_.clear(std::memory_order_release);
     uint64_t u = 1;
     ::write(notify_fd, &u, sizeof(uint64_t));
 }
@@ -157,14 +214,15 @@ void Reactor::submit_task(std::function<void()> task) {
 void Reactor::run() {
     const int MAX_EVENTS =128;  // 增大批量处理能力
     struct epoll_event events[MAX_EVENTS];
+    running_ = true;
 
-    while (true) {
-        // 先处理 pending tasks
-        while (!pending_tasks.empty()) {
-            auto task = std::move(pending_tasks.front());
-            pending_tasks.pop_front();
-            task();
-        }
+    while (!stopped_) {
+        // 收回其他 shard 归还给本 shard 对象池的节点，并发出本 shard 攒下的归还批次
+        PoolRegistry::local().drain_remote_frees();
+        if (memory::enabled()) memory::drain_remote_frees();
+        ShardBufferBudget::local().drain_remote_releases();
+
+        run_pending_tasks();
 
         int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
         for (int i = 0; i < n; ++i) {
@@ -186,6 +244,48 @@ void Reactor::run() {
             }
         }
     }
+    // stop() 之前已经排队的 continuation（例如 stop 时关闭的连接上，读循环收到的空 Packet）执行完再返回
+    run_pending_tasks();
+    running_ = false;
+}
+
+void Reactor::run_pending_tasks() {
+    // 先处理 pending tasks，再执行本轮攒下的收尾回调；
+    // 收尾回调（例如 flush 完成后兑现的 promise）可能产生新任务，全部处理完才进入 epoll_wait
+    do {
+        while (!pending_tasks.empty()) {
+            auto task = std::move(pending_tasks.front());
+            pending_tasks.pop_front();
+            task();
+        }
+
+        if (!iteration_end_hooks_.empty()) {
+            running_hooks_.swap(iteration_end_hooks_);
+            for (auto& hook : running_hooks_) hook();
+            running_hooks_.clear();
+        }
+    } while (!pending_tasks.empty() || !iteration_end_hooks_.empty());
+}
+
+void Reactor::at_iteration_end(std::function<void()> fn) {
+    iteration_end_hooks_.push_back(std::move(fn));
+}
+
+void Reactor::at_stop(std::function<void()> fn) {
+    stop_hooks_.push_back(std::move(fn));
+}
+
+void Reactor::run_stop_hooks() {
+    auto hooks = std::move(stop_hooks_);
+    stop_hooks_.clear();
+    for (auto& hook : hooks) hook();
+}
+
+void Reactor::stop() {
+    stopped_ = true;
+    // 自己给自己发一次通知，保证不会卡在 epoll_wait 里
+    uint64_t u = 1;
+    ::write(notify_fd, &u, sizeof(uint64_t));
 }
 
 void Reactor::handle_incoming_tasks() {
@@ -11,16 +11,21 @@
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
 #include <thread>
+#include <atomic>
 #include "Future.h"
 #include "SpscQueue.h"
+#include "Gate.h"
 
 using Clock = std::chrono::steady_clock;
 using TimePoint = std::chrono::time_point<Clock>;
 
+using TimerId = uint64_t;
+
+// 堆里只放 (到期时间, id)，回调放在 timer_callbacks_ 里：
+// cancel_timer 直接删掉回调即可立刻释放它捕获的资源，堆中残留的条目出堆时跳过
 struct TimerTask {
     TimePoint expire_time;
-    std::function<void()> callback;
-    uint64_t id;
+    TimerId id;
     bool operator>(const TimerTask& other) const {
         return expire_time > other.expire_time;
     }
@@ -40,11 +45,25 @@ private:
 
     std::priority_queue<TimerTask, std::vector<TimerTask>,
                         std::greater<TimerTask>> timers_;
+    std::unordered_map<TimerId, std::function<void()>> timer_callbacks_;
+    TimerId next_timer_id_ = 1;
 
     std::unordered_map<int, EventHandler> handlers;
     std::deque<std::function<void()>> pending_tasks;
+    // 本轮迭代处理完所有任务、进入 epoll_wait 之前执行的回调（例如连接的批量 flush）
+    std::vector<std::function<void()>> iteration_end_hooks_;
+    std::vector<std::function<void()>> running_hooks_;   // 与上面交替使用，稳态下不再分配
+    std::vector<std::function<void()>> stop_hooks_;      // 见 at_stop
+
+    SpscQueue<std::function<void()>,1024> cross_core_queue_;
+    // 多个 shard 可能同时向同一个 Reactor 投递任务，而队列是单生产者的：
+    // 生产端用自旋锁串行化，消费端保持无锁
+    std::atomic_flag submit_lock_ = ATOMIC_FLAG_INIT;
 
-    std::vector<<std::function<void()>,1024>> cross_core_queue_;
+    // 本 shard 的在途操作，stop 前由 Engine 关闭并等待归零
+    Gate gate_;
+    bool stopped_ = false;
+    bool running_ = false;  // run() 的事件循环进行中
 
     static thread_local Reactor* instance_;
 
@@ -69,13 +88,34 @@ public:
     void schedule(std::function<void()> task);
     void submit_task(std::function<void()> task);
     void run();
+    // Engine 先调用 user_main，返回后才进入 run()：为 false 时本线程还可以做阻塞的启动步骤
+    bool running() const { return running_; }
+
+    // 在本轮迭代的任务全部执行完、阻塞在 epoll_wait 之前调用一次 fn
+    void at_iteration_end(std::function<void()> fn);
+
+    // 让 run() 在当前迭代结束后返回，只能在本 Reactor 线程上调用
+    void stop();
+
+    // Engine::stop 关闭本 shard 的 Gate 之后调用一次 fn：长期持有 Gate 的对象（例如空闲的连接）
+    // 在这里主动收尾，否则 Gate 永远等不到归零
+    void at_stop(std::function<void()> fn);
+    void run_stop_hooks();
+
+    Gate& gate() { return gate_; }
+
+    TimerId run_at(TimePoint timestamp, std::function<void()> callback);
+    TimerId run_after(int delay_ms, std::function<void()> callback);
 
-    void run_at(TimePoint timestamp, std::function<void()> callback);
-    void run_after(int delay_ms, std::function<void()> callback);
+    // 取消尚未触发的定时器，返回 false 表示已触发或不存在
+    bool cancel_timer(TimerId id);
     Future<void> sleep(int seconds);
 
 private:
     void handle_incoming_tasks();
+    void run_pending_tasks();
     void reset_timer_fd();
     void handle_timer_events();
+    void compact_timers();
+    void schedule_pool_trim();
 };
\ No newline at end of file
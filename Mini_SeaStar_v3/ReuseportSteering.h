@@ -0,0 +1,255 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * SO_REUSEPORT 分流策略
+ * 每个 shard 在同一端口上各有一个监听 socket，默认由内核按四元组哈希选择，既不知道收包的
+ * 软中断跑在哪个核上，也不知道各 shard 有多忙。这里给 reuseport 组挂一个 BPF 程序，
+ * 返回值就是组内 socket 的下标：
+ *   kIncomingCpu  经典 BPF：取处理该 SYN 的 CPU 编号（即网卡队列中断所在的核）对 shard 数取模，
+ *                 连接交给同一个核上的 shard，握手与后续收包都不跨核
+ *   kLeastLoaded  eBPF：从 BPF array map 中读各 shard 当前的连接数，选最少的一个；
+ *                 各 shard 通过 mmap 的 map 内存直接发布自己的连接数，不需要系统调用
+ *
+ * 组内下标等于 listen() 的先后顺序，所以各 shard 必须按编号依次 listen（join_in_order），
+ * 并且 shard i 钉在 CPU i 上（Engine 保证）。程序加载失败时退回内核默认的哈希分流
+ */
+namespace reuseport {
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+#ifndef SO_ATTACH_REUSEPORT_EBPF
+#define SO_ATTACH_REUSEPORT_EBPF 52
+#endif
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+
+enum class Steering { kHash, kIncomingCpu, kLeastLoaded };
+
+inline long bpf(int cmd, union bpf_attr* attr) {
+    return ::syscall(SYS_bpf, cmd, attr, sizeof(*attr));
+}
+
+// 同一端口的监听 socket 按 shard 编号依次加入 reuseport 组
+// 这是一个启动屏障：编号更大的 shard 在 mutex/condvar 上阻塞等待前面的 shard 轮完（成功或失败），
+// 最长 kJoinTimeout。只能在 Reactor 事件循环开始之前调用（Engine::run 的 user_main 中），
+// 循环已经开始时 TcpServer::listen 不会调用它，直接退回哈希分流，不会卡住事件循环
+// 前面的 shard 抛异常或 kJoinTimeout 内没有轮到时，组内下标已经对不上编号：
+// 之后的 shard 不再等待，返回 false，调用方退回哈希分流；do_listen 的异常继续抛给调用方
+// nr_shards 个 shard 都轮完后清除该端口的记录，同一端口可以再 listen 一轮
+constexpr std::chrono::seconds kJoinTimeout{5};
+
+inline bool join_in_order(int port, int shard, int nr_shards, const std::function<void()>& do_listen) {
+    struct Turns {
+        int done = 0;          // 已轮完的 shard 数
+        bool broken = false;   // 有 shard 失败或超时
+    };
+    static std::mutex mu;
+    static std::condition_variable cv;
+    static std::unordered_map<int, Turns> ports;
+
+    std::unique_lock<std::mutex> lock(mu);
+    if (!cv.wait_for(lock, kJoinTimeout, [&] { return ports[port].done == shard || ports[port].broken; })) {
+        ports[port].broken = true;
+    }
+    bool ordered = !ports[port].broken;
+
+    // 无论成功与否都让出轮次，否则后面的 shard 永远等下去
+    auto finish = [&](bool ok) {
+        Turns& t = ports[port];
+        if (!ok) t.broken = true;
+        if (++t.done == nr_shards) ports.erase(port);
+        cv.notify_all();
+    };
+    try {
+        do_listen();
+    } catch (...) {
+        finish(false);
+        throw;
+    }
+    finish(true);
+    return ordered;
+}
+
+// kIncomingCpu：A = 收包 CPU；A %= nr_shards；return A
+inline bool attach_incoming_cpu(int fd, int nr_shards) {
+    struct sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(nr_shards)},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog prog{static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code};
+    return ::setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
+
+/**
+ * 进程内所有 shard 共享的连接数表：BPF_MAP_TYPE_ARRAY，第 i 个元素是 shard i 的连接数（u64）
+ * 支持 BPF_F_MMAPABLE（5.5+）时映射到用户态，发布就是一次普通的原子写；
+ * 否则退回 BPF_MAP_UPDATE_ELEM 系统调用
+ */
+class LoadTable {
+private:
+    int map_fd_ = -1;
+    int nr_shards_ = 0;
+    uint64_t* values_ = nullptr;  // mmap 的 map 内存，元素按 8 字节排列
+    size_t mapped_bytes_ = 0;
+
+    LoadTable(int nr_shards) : nr_shards_(nr_shards) {
+        union bpf_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.map_type = BPF_MAP_TYPE_ARRAY;
+        attr.key_size = sizeof(uint32_t);
+        attr.value_size = sizeof(uint64_t);
+        attr.max_entries = static_cast<uint32_t>(nr_shards);
+        attr.map_flags = BPF_F_MMAPABLE;
+        map_fd_ = static_cast<int>(bpf(BPF_MAP_CREATE, &attr));
+        if (map_fd_ >= 0) {
+            size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            mapped_bytes_ = (nr_shards * sizeof(uint64_t) + page - 1) / page * page;
+            void* p = ::mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, map_fd_, 0);
+            if (p != MAP_FAILED) values_ = static_cast<uint64_t*>(p);
+        } else {
+            attr.map_flags = 0;
+            map_fd_ = static_cast<int>(bpf(BPF_MAP_CREATE, &attr));
+        }
+    }
+
+public:
+    // 第一次调用时创建；之后的调用返回同一张表（nr_shards 以第一次为准）
+    static LoadTable* get(int nr_shards) {
+        static std::mutex mu;
+        static LoadTable* table = nullptr;
+        std::lock_guard<std::mutex> lock(mu);
+        if (!table) table = new LoadTable(nr_shards);  // 进程生命周期内一直有效
+        return table->map_fd_ >= 0 ? table : nullptr;
+    }
+
+    int map_fd() const { return map_fd_; }
+    int nr_shards() const { return nr_shards_; }
+
+    void publish(int shard, uint64_t connections) {
+        if (shard < 0 || shard >= nr_shards_) return;
+        if (values_) {
+            __atomic_store_n(&values_[shard], connections, __ATOMIC_RELAXED);
+            return;
+        }
+        uint32_t key = static_cast<uint32_t>(shard);
+        union bpf_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.map_fd = static_cast<uint32_t>(map_fd_);
+        attr.key = reinterpret_cast<uint64_t>(&key);
+        attr.value = reinterpret_cast<uint64_t>(&connections);
+        attr.flags = BPF_ANY;
+        bpf(BPF_MAP_UPDATE_ELEM, &attr);
+    }
+
+    uint64_t load(int shard) const {
+        if (values_) return __atomic_load_n(&values_[shard], __ATOMIC_RELAXED);
+        uint32_t key = static_cast<uint32_t>(shard);
+        uint64_t value = 0;
+        union bpf_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.map_fd = static_cast<uint32_t>(map_fd_);
+        attr.key = reinterpret_cast<uint64_t>(&key);
+        attr.value = reinterpret_cast<uint64_t>(&value);
+        bpf(BPF_MAP_LOOKUP_ELEM, &attr);
+        return value;
+    }
+};
+
+// 本 shard 接受的入站连接数：accept 出来的 TcpConnection 构造 / 析构时更新（connect() 建立的出站连接不计入，
+// 它们不经过 reuseport 分流），开启 kLeastLoaded 后同步发布到 LoadTable
+struct ShardLoad {
+    static inline thread_local uint64_t connections = 0;
+    static inline thread_local LoadTable* table = nullptr;
+    static inline thread_local int shard = -1;
+
+    static void opened() {
+        ++connections;
+        if (table) table->publish(shard, connections);
+    }
+
+    static void closed() {
+        --connections;
+        if (table) table->publish(shard, connections);
+    }
+};
+
+namespace detail {
+
+// 手工汇编 eBPF 指令（不依赖 libbpf / clang）
+inline bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+    bpf_insn i;
+    std::memset(&i, 0, sizeof(i));
+    i.code = code;
+    i.dst_reg = dst;
+    i.src_reg = src;
+    i.off = off;
+    i.imm = imm;
+    return i;
+}
+
+} // namespace detail
+
+/**
+ * kLeastLoaded 的程序，按 shard 数展开循环（不依赖 5.3+ 的有界循环）：
+ *   r6 = 0; r7 = UINT64_MAX
+ *   对每个 i：key = i; r0 = map_lookup_elem(map, &key)
+ *            if r0 && *r0 < r7 { r7 = *r0; r6 = i }
+ *   return r6
+ * 连接数相同时取编号最小的 shard
+ */
+inline bool attach_least_loaded(int fd, LoadTable* table) {
+    using detail::insn;
+    std::vector<bpf_insn> code;
+    code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_6, 0, 0, 0));
+    code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_7, 0, 0, -1));
+    for (int i = 0; i < table->nr_shards(); ++i) {
+        code.push_back(insn(BPF_ST | BPF_MEM | BPF_W, BPF_REG_10, 0, -4, i));
+        // ld_imm64 r1 = map（两条指令）
+        code.push_back(insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, table->map_fd()));
+        code.push_back(insn(0, 0, 0, 0, 0));
+        code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0));
+        code.push_back(insn(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4));
+        code.push_back(insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem));
+        code.push_back(insn(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, 4, 0));
+        code.push_back(insn(BPF_LDX | BPF_MEM | BPF_DW, BPF_REG_1, BPF_REG_0, 0, 0));
+        code.push_back(insn(BPF_JMP | BPF_JGE | BPF_X, BPF_REG_1, BPF_REG_7, 2, 0));
+        code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_7, BPF_REG_1, 0, 0));
+        code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_6, 0, 0, i));
+    }
+    code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_0, BPF_REG_6, 0, 0));
+    code.push_back(insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+    static const char license[] = "GPL";
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+    attr.insns = reinterpret_cast<uint64_t>(code.data());
+    attr.insn_cnt = static_cast<uint32_t>(code.size());
+    attr.license = reinterpret_cast<uint64_t>(license);
+    int prog_fd = static_cast<int>(bpf(BPF_PROG_LOAD, &attr));
+    if (prog_fd < 0) return false;
+
+    bool ok = ::setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF, &prog_fd, sizeof(prog_fd)) == 0;
+    ::close(prog_fd);  // reuseport 组持有程序的引用
+    return ok;
+}
+
+} // namespace reuseport
@@ -9,7 +9,12 @@
 #include <condition_variable>
 #include <pthread.h>
 #include <sched.h>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
 #include "Reactor.h"
+#include "Numa.h"
 
 namespace seastar{
     inline std::vector<Reactor*> g_reactors;
@@ -23,6 +28,8 @@ namespace seastar{
     private:
         std::vector<std::thread> threads_;
         std::atomic<int> ready_count_{0};
+        std::atomic<int> exited_count_{0};
+        std::atomic<bool> running_{false};
 
         int num_cpus_;
 
@@ -37,6 +44,7 @@ namespace seastar{
         
         template <typename Func>
         void run(Func&& user_main){
+            running_=true;
             for(int i=0;i<num_cpus_;++i){
                 threads_.emplace_back([this,i,user_main](){
                     g_cpu_id=i;
@@ -49,6 +57,8 @@ namespace seastar{
                     if(rc!=0){
                         std::cerr<<"Error calling pthread_setaffinity_np on core"<<i<<std::endl;
                     }
+                    // 钉核之后再确定本 shard 的 NUMA 节点，此后池 chunk 和 Memory.cpp 区域都绑定到这个节点
+                    numa::refresh_local_node();
 
                     Reactor reactor;
                     g_reactors[i]=&reactor;
@@ -60,17 +70,36 @@ namespace seastar{
 
                     user_main();
                     reactor.run();
+
+                    // 等所有 shard 都退出循环后再析构 Reactor，
+                    // 避免别的 shard 在收尾时 submit_to 到已析构的 Reactor
+                    exited_count_++;
+                    while(exited_count_<num_cpus_){
+                        std::this_thread::yield();
+                    }
                 });
             }
 
             for(auto& t:threads_){
                 if(t.joinable()) t.join();
             }
+            running_=false;
         }
 
+        // 通知所有 Reactor 退出：每个 shard 先关闭自己的 Gate（不再接受新连接），
+        // 再运行 at_stop 回调关闭仍打开的连接，等在途操作全部 leave 之后停止事件循环
         void stop(){
-            // 这里未来可以实现通知所有 Reactor 退出循环
-        // 目前先留空
+            if(!running_.exchange(false)) return;
+            for(int i=0;i<num_cpus_;++i){
+                submit_to(i,[](){
+                    Reactor* r=Reactor::instance();
+                    auto drained=r->gate().close();
+                    r->run_stop_hooks();
+                    drained.then([r](){
+                        r->stop();
+                    });
+                });
+            }
         }
 
         static void submit_to(int cpu_id,std::function<void()> task){
@@ -78,4 +107,66 @@ namespace seastar{
             g_reactors[cpu_id]->submit_task(std::move(task));
         }
     };
+
+    struct ShardPoolStats{
+        int shard;
+        int node;                       // shard 所在的 NUMA 节点
+        numa::AccessStats numa_access;  // 采样到的远端节点访问
+        std::vector<PoolStats> pools;
+    };
+
+    // 收集所有 shard 的对象池快照：向每个 shard 投递一个采集任务，
+    // 结果再投递回调用方 shard 汇总，全程不跨线程共享可变状态
+    // 必须在某个 shard 上调用
+    inline Future<std::vector<ShardPoolStats>> collect_pool_stats(){
+        struct Collector{
+            Promise<std::vector<ShardPoolStats>> promise;
+            std::vector<ShardPoolStats> result;
+            size_t pending=0;
+        };
+
+        int origin=cpu_id();
+        auto* c=new Collector();   // 只在 origin shard 上被访问和释放
+        c->pending=g_reactors.size();
+        auto fut=c->promise.get_future();
+
+        for(int i=0;i<static_cast<int>(g_reactors.size());++i){
+            Engine::submit_to(i,[c,origin,i](){
+                auto pools=PoolRegistry::local().stats();
+                int node=numa::local_node();
+                numa::AccessStats access=numa::access_stats();
+                Engine::submit_to(origin,[c,i,node,access,pools](){
+                    c->result.push_back({i,node,access,pools});
+                    if(--c->pending==0){
+                        std::sort(c->result.begin(),c->result.end(),
+                            [](const ShardPoolStats& a,const ShardPoolStats& b){return a.shard<b.shard;});
+                        c->promise.set_value(std::move(c->result));
+                        delete c;
+                    }
+                });
+            });
+        }
+        return fut;
+    }
+
+    inline std::string format_pool_stats(const std::vector<ShardPoolStats>& all){
+        std::ostringstream out;
+        out<<std::left<<std::setw(6)<<"shard"<<std::setw(40)<<"type"
+           <<std::right<<std::setw(8)<<"size"<<std::setw(10)<<"live"<<std::setw(10)<<"free"
+           <<std::setw(8)<<"chunks"<<std::setw(8)<<"remote"<<std::setw(10)<<"peak"<<std::setw(12)<<"bytes"<<"\n";
+        for(const auto& shard:all){
+            for(const auto& p:shard.pools){
+                out<<std::left<<std::setw(6)<<shard.shard<<std::setw(40)<<p.type_name.substr(0,39)
+                   <<std::right<<std::setw(8)<<p.object_size<<std::setw(10)<<p.live<<std::setw(10)<<p.free
+                   <<std::setw(8)<<p.chunks<<std::setw(8)<<p.remote_chunks<<std::setw(10)<<p.peak_live
+                   <<std::setw(12)<<p.chunks*p.chunk_bytes<<"\n";
+            }
+        }
+        for(const auto& shard:all){
+            out<<"shard "<<shard.shard<<" numa node "<<shard.node
+               <<": sampled "<<shard.numa_access.sampled<<" buffer accesses, "
+               <<shard.numa_access.remote<<" remote\n";
+        }
+        return out.str();
+    }
 }
\ No newline at end of file
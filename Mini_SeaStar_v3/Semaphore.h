@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include "Future.h"
+#include "WaitQueue.h"
+
+/**
+ * Shard 本地的异步信号量
+ * 用于限制每个 shard / 每个上游的在途请求数，wait() 不会阻塞 Reactor，
+ * 拿不到信号量时返回一个挂起的 Future，signal() 按 FIFO 顺序唤醒
+ * wait() 的结果为 true 表示拿到了信号量；为 false 表示信号量已 broken() 或被销毁，
+ * 此时没有拿到任何名额，也不能再访问这个 Semaphore
+ * 注意：不是线程安全的，只能在创建它的 shard 上使用
+ */
+class Semaphore
+{
+    size_t count_;
+    bool broken_ = false;
+    WaitQueue waiters_;
+
+public:
+    explicit Semaphore(size_t count) : count_(count) {}
+
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    Future<bool> wait(size_t units = 1) {
+        if (broken_) return Future<bool>::make_ready(false);
+        // 只有没人排队时才能走快路径，否则会插队破坏 FIFO
+        if (waiters_.empty() && count_ >= units) {
+            count_ -= units;
+            return Future<bool>::make_ready(true);
+        }
+
+        Waiter* w = new Waiter();
+        w->units = units;
+        auto fut = w->promise.get_future();
+        waiters_.push_back(w);
+        return fut;
+    }
+
+    bool try_wait(size_t units = 1) {
+        if (!broken_ && waiters_.empty() && count_ >= units) {
+            count_ -= units;
+            return true;
+        }
+        return false;
+    }
+
+    void signal(size_t units = 1) {
+        count_ += units;
+        while (!waiters_.empty() && count_ >= waiters_.front()->units) {
+            Waiter* w = waiters_.pop_front();
+            count_ -= w->units;
+            w->promise.set_value(true);
+            delete w;
+        }
+    }
+
+    // 以 false 唤醒所有排队者，之后的 wait() 也立即得到 false（例如所属的连接池停止时）
+    void broken() {
+        broken_ = true;
+        waiters_.break_all();
+    }
+
+    bool is_broken() const { return broken_; }
+    size_t available_units() const { return count_; }
+    size_t waiters() const { return waiters_.size(); }
+};
+
+/**
+ * 信号量的 RAII 持有者：析构时自动 signal，防止异常路径/提前 return 泄漏名额
+ */
+class SemaphoreUnits
+{
+    Semaphore* sem_ = nullptr;
+    size_t units_ = 0;
+
+public:
+    SemaphoreUnits() = default;
+    SemaphoreUnits(Semaphore* sem, size_t units) : sem_(sem), units_(units) {}
+
+    SemaphoreUnits(const SemaphoreUnits&) = delete;
+    SemaphoreUnits& operator=(const SemaphoreUnits&) = delete;
+
+    SemaphoreUnits(SemaphoreUnits&& other) noexcept
+        : sem_(other.sem_), units_(other.units_) {
+        other.sem_ = nullptr;
+        other.units_ = 0;
+    }
+
+    SemaphoreUnits& operator=(SemaphoreUnits&& other) noexcept {
+        if (this != &other) {
+            return_all();
+            sem_ = other.sem_;
+            units_ = other.units_;
+            other.sem_ = nullptr;
+            other.units_ = 0;
+        }
+        return *this;
+    }
+
+    ~SemaphoreUnits() { return_all(); }
+
+    // 提前归还一部分
+    void return_units(size_t units) {
+        if (units > units_) throw std::logic_error("Cannot return more units than held");
+        units_ -= units;
+        if (sem_ && units > 0) sem_->signal(units);
+    }
+
+    void return_all() {
+        if (sem_ && units_ > 0) sem_->signal(units_);
+        units_ = 0;
+    }
+
+    // 放弃所有权，不再自动归还
+    size_t release() {
+        size_t n = units_;
+        units_ = 0;
+        sem_ = nullptr;
+        return n;
+    }
+
+    size_t count() const { return units_; }
+};
+
+// 信号量损坏或销毁时得到空的 SemaphoreUnits（count() == 0），不会再访问它
+inline Future<SemaphoreUnits> get_units(Semaphore& sem, size_t units = 1) {
+    Semaphore* s = &sem;
+    return sem.wait(units).then([s, units](bool ok) {
+        return ok ? SemaphoreUnits(s, units) : SemaphoreUnits();
+    });
+}
+
+inline bool try_get_units(Semaphore& sem, size_t units, SemaphoreUnits& out) {
+    if (!sem.try_wait(units)) return false;
+    out = SemaphoreUnits(&sem, units);
+    return true;
+}
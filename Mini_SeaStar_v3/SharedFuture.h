@@ -0,0 +1,142 @@
+#pragma once
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Future.h"
+#include "IntrusivePtr.h"
+#include "Poolable.h"
+
+/**
+ * SharedFuture：一个结果，多个等待者
+ * Future<T> 的 State 只有一个 callback 槽位，只能挂一个 continuation；
+ * SharedFuture 在此之上做扇出：结果只保存一份，then() 的 continuation 以 const T& 访问，
+ * 大对象不会为每个等待者复制一次
+ * SharedFuture 本身是轻量句柄（LocalPtr），可随意拷贝，仅限本 shard 使用
+ */
+template<typename T>
+class SharedFuture
+{
+    static_assert(!std::is_void_v<T>, "SharedFuture<void> is not supported");
+
+    struct SharedState : public RefCounted<SharedState>, public Poolable<SharedState>
+    {
+        T value;
+        bool ready = false;
+        bool fanning_out = false;   // 扇出任务已预约但还没跑完，新来的等待者必须排在后面
+        std::vector<std::function<void(const T&)>> waiters;
+
+        void resolve(T v) {
+            value = std::move(v);
+            ready = true;
+            if (waiters.empty()) return;
+
+            // 所有等待者在同一个任务里依次执行，只经过调度器一次
+            // 扇出期间（包括等待者自己）新挂上的等待者追加到队尾，同样在这个任务里按顺序执行
+            fanning_out = true;
+            schedule_task([s = LocalPtr<SharedState>(this)]() {
+                for (size_t i = 0; i < s->waiters.size(); ++i) {
+                    auto w = std::move(s->waiters[i]);
+                    w(s->value);
+                }
+                s->waiters.clear();
+                s->fanning_out = false;
+            });
+        }
+
+        void add_waiter(std::function<void(const T&)> w) {
+            if (ready && !fanning_out) {
+                w(value);
+            } else {
+                waiters.push_back(std::move(w));
+            }
+        }
+    };
+
+    LocalPtr<SharedState> state_;
+
+public:
+    explicit SharedFuture(Future<T> f) : state_(make_local<SharedState>()) {
+        f.on_ready([s = state_](T v) {
+            s->resolve(std::move(v));
+        });
+    }
+
+    bool available() const { return state_->ready; }
+
+    // 已就绪时直接访问结果，不复制
+    const T& get() const {
+        if (!available()) throw std::logic_error("SharedFuture not ready");
+        return state_->value;
+    }
+
+    template<typename Func>
+    auto then(Func func) {
+        using R = std::invoke_result_t<Func, const T&>;
+        using U = typename Futurize<R>::value_type;
+
+        auto next_promise = make_local<Promise<U>>();
+        auto next_future = next_promise->get_future();
+
+        state_->add_waiter([p = next_promise, f = std::move(func)](const T& value) mutable {
+            Futurize<R>::apply(f, p, value);
+        });
+        return next_future;
+    }
+
+    // 底层挂接：不创建下一阶段的 Promise，与 then() 的等待者按同一个顺序执行
+    void on_ready(std::function<void(const T&)> cb) {
+        state_->add_waiter(std::move(cb));
+    }
+
+    // 取一个独立的 Future<T>（会复制一次结果，适合 Packet 这类廉价可拷贝的类型）
+    Future<T> get_future() {
+        return then([](const T& v) { return v; });
+    }
+
+    size_t waiters() const { return state_->waiters.size(); }
+};
+
+/**
+ * SingleFlight：按 key 合并并发的相同请求
+ * 同一个 key 的请求在途时，后来者直接挂到同一个 SharedFuture 上，
+ * 慢路径（回源、冷数据加载）只执行一次；结果出来后 key 立即移出表，下次请求重新加载
+ * 每个 shard 持有自己的实例（通常是 static thread_local），实例必须比在途请求活得久
+ */
+template<typename Key, typename T, typename Hash = std::hash<Key>>
+class SingleFlight
+{
+    std::unordered_map<Key, SharedFuture<T>, Hash> in_flight_;
+    uint64_t coalesced_ = 0;
+
+public:
+    SingleFlight() = default;
+
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    // loader: () -> Future<T>，仅在该 key 没有在途请求时调用
+    template<typename Loader>
+    SharedFuture<T> get(const Key& key, Loader loader) {
+        auto it = in_flight_.find(key);
+        if (it != in_flight_.end()) {
+            ++coalesced_;
+            return it->second;
+        }
+
+        SharedFuture<T> sf(loader());
+        if (sf.available()) return sf;
+
+        in_flight_.emplace(key, sf);
+        // 第一个挂上的等待者：结果到达时先把 key 移出表
+        sf.on_ready([this, key](const T&) {
+            in_flight_.erase(key);
+        });
+        return sf;
+    }
+
+    size_t in_flight() const { return in_flight_.size(); }
+    uint64_t coalesced() const { return coalesced_; }
+};
@@ -7,6 +7,9 @@
 #include <cstring>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
+#include <sys/un.h>
+#include <cstddef>
+#include <string>
 
 class Socket{
 private:
@@ -46,6 +49,39 @@ public:
         return Socket(fd);
     }
 
+    // Unix 域流式 socket：本机 sidecar / 代理之间通信，不经过 TCP 协议栈
+    static Socket create_unix(){
+        int fd = ::socket(AF_UNIX,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+        if(fd<0) throw std::runtime_error("socket failed");
+        return Socket(fd);
+    }
+
+    // 以 '@' 开头的路径表示抽象命名空间（Linux 特有）：不在文件系统中创建文件，
+    // 最后一个引用关闭时自动消失，不需要 unlink
+    static bool is_abstract(const std::string& path){
+        return !path.empty()&&path[0]=='@';
+    }
+
+    static socklen_t make_unix_addr(const std::string& path,struct sockaddr_un& addr){
+        std::memset(&addr,0,sizeof(addr));
+        addr.sun_family=AF_UNIX;
+        if(path.empty()||path.size()>=sizeof(addr.sun_path)){
+            throw std::runtime_error("invalid unix socket path");
+        }
+        std::memcpy(addr.sun_path,path.data(),path.size());
+        if(is_abstract(path)){
+            addr.sun_path[0]='\0';
+            return static_cast<socklen_t>(offsetof(struct sockaddr_un,sun_path)+path.size());
+        }
+        return static_cast<socklen_t>(offsetof(struct sockaddr_un,sun_path)+path.size()+1);
+    }
+
+    static Socket create_udp(){
+        int fd = ::socket(AF_INET,SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+        if(fd<0) throw std::runtime_error("socket failed");
+        return Socket(fd);
+    }
+
     void bind(int port){
         struct sockaddr_in addr;
         std::memset(&addr,0,sizeof(addr));
@@ -59,6 +95,16 @@ public:
         }
     }
 
+    // 文件系统路径上残留的旧 socket 文件会让 bind 失败，先删除
+    void bind_unix(const std::string& path){
+        struct sockaddr_un addr;
+        socklen_t len=make_unix_addr(path,addr);
+        if(!is_abstract(path)) ::unlink(path.c_str());
+        if(::bind(fd_,reinterpret_cast<struct sockaddr*>(&addr),len)<0){
+            throw std::runtime_error("bind failed");
+        }
+    }
+
     void listen(){
         if(::listen(fd_,SOMAXCONN)<0){
             throw std::runtime_error("listen failed");
@@ -119,6 +165,19 @@ public:
         throw std::runtime_error("connect failed");
     }
 
+    // Unix 域 socket 的连接要么立即完成，要么因对端 backlog 已满返回 EAGAIN（返回 false，稍后重试）
+    bool connect_unix(const std::string& path){
+        struct sockaddr_un addr;
+        socklen_t len=make_unix_addr(path,addr);
+        if(::connect(fd_,reinterpret_cast<struct sockaddr*>(&addr),len)==0){
+            return true;
+        }
+        if(errno==EAGAIN){
+            return false;
+        }
+        throw std::runtime_error("connect failed");
+    }
+
     void set_tcp_no_delay(bool on){
         int opt=on?1:0;
         ::setsockopt(fd_,IPPROTO_TCP,TCP_NODELAY,&opt,sizeof(opt));
@@ -138,4 +197,40 @@ public:
         int opt=on?1:0;
         ::setsockopt(fd_,SOL_SOCKET,SO_KEEPALIVE,&opt,sizeof(opt));
     }
+
+    // 监听 socket：握手完成后等客户端发来数据（最多 secs 秒）才让 accept 返回
+    void set_defer_accept(int secs){
+        ::setsockopt(fd_,IPPROTO_TCP,TCP_DEFER_ACCEPT,&secs,sizeof(secs));
+    }
+
+    // 监听 socket：开启 TFO，qlen 为尚未完成握手的 TFO 请求队列长度
+    // 还需要 net.ipv4.tcp_fastopen 打开服务端位（值含 2）
+    void set_fast_open(int qlen){
+        ::setsockopt(fd_,IPPROTO_TCP,TCP_FASTOPEN,&qlen,sizeof(qlen));
+    }
+
+    // 客户端 socket：connect 先返回，第一次 write 的数据随 SYN 发出（已有 cookie 时）
+    void set_fast_open_connect(bool on){
+        int opt=on?1:0;
+        ::setsockopt(fd_,IPPROTO_TCP,TCP_FASTOPEN_CONNECT,&opt,sizeof(opt));
+    }
+
+    // 监听 socket 要在 listen 之前设置，窗口扩大因子在握手时确定
+    void set_recv_buffer(int bytes){
+        ::setsockopt(fd_,SOL_SOCKET,SO_RCVBUF,&bytes,sizeof(bytes));
+    }
+
+    void set_send_buffer(int bytes){
+        ::setsockopt(fd_,SOL_SOCKET,SO_SNDBUF,&bytes,sizeof(bytes));
+    }
+
+    // 发送队列中未发出的字节低于 bytes 时才报告可写，减少积压在内核里的数据
+    void set_notsent_lowat(int bytes){
+        ::setsockopt(fd_,IPPROTO_TCP,TCP_NOTSENT_LOWAT,&bytes,sizeof(bytes));
+    }
+
+    // 阻塞读 / epoll 等不到数据时先忙轮询网卡队列 usecs 微秒（调高需要 CAP_NET_ADMIN）
+    void set_busy_poll(int usecs){
+        ::setsockopt(fd_,SOL_SOCKET,SO_BUSY_POLL,&usecs,sizeof(usecs));
+    }
 };
\ No newline at end of file
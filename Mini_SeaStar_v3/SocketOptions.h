@@ -0,0 +1,53 @@
+#pragma once
+#include "Socket.h"
+
+/**
+ * 声明式的 socket 选项配置：TcpServer::set_options 在 listen 之前调用，客户端 socket 用 apply_client
+ *
+ * 下面这些选项都设置在监听 socket 上，accept 出来的连接由内核复制监听 socket 的状态而继承，
+ * 每个新连接不需要再额外做 setsockopt 系统调用
+ * 取值为 0 / false 表示不设置，保持内核默认
+ */
+struct SocketOptions {
+    bool no_delay = false;        // TCP_NODELAY：关闭 Nagle，小响应立即发出
+    bool keep_alive = false;      // SO_KEEPALIVE
+    int defer_accept = 0;         // TCP_DEFER_ACCEPT（秒）：只在请求数据到达后唤醒 accept，只对监听 socket 有效
+    int fast_open = 0;            // TCP_FASTOPEN 队列长度：服务端接受随 SYN 携带的数据，只对监听 socket 有效
+    bool fast_open_connect = false;  // TCP_FASTOPEN_CONNECT：客户端的第一次写随 SYN 发出，只对客户端有效
+    int recv_buffer = 0;          // SO_RCVBUF（字节，内核会翻倍）
+    int send_buffer = 0;          // SO_SNDBUF
+    int notsent_lowat = 0;        // TCP_NOTSENT_LOWAT（字节）
+    int busy_poll = 0;            // SO_BUSY_POLL（微秒）
+
+    // 短请求 / 响应的服务：关闭 Nagle，有数据才 accept，允许 TFO
+    static SocketOptions low_latency() {
+        SocketOptions o;
+        o.no_delay = true;
+        o.defer_accept = 1;
+        o.fast_open = 256;
+        return o;
+    }
+
+    // 在 bind / listen 之前调用
+    void apply_listener(Socket& sock) const {
+        apply_common(sock);
+        if (defer_accept > 0) sock.set_defer_accept(defer_accept);
+        if (fast_open > 0) sock.set_fast_open(fast_open);
+    }
+
+    // 在 connect 之前调用
+    void apply_client(Socket& sock) const {
+        apply_common(sock);
+        if (fast_open_connect) sock.set_fast_open_connect(true);
+    }
+
+private:
+    void apply_common(Socket& sock) const {
+        if (no_delay) sock.set_tcp_no_delay(true);
+        if (keep_alive) sock.set_keep_alive(true);
+        if (recv_buffer > 0) sock.set_recv_buffer(recv_buffer);
+        if (send_buffer > 0) sock.set_send_buffer(send_buffer);
+        if (notsent_lowat > 0) sock.set_notsent_lowat(notsent_lowat);
+        if (busy_poll > 0) sock.set_busy_poll(busy_poll);
+    }
+};
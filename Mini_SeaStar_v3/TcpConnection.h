@@ -2,18 +2,152 @@
 #include <memory>
 #include <vector>
 #include <deque>
+#include <unordered_map>
 #include <iostream>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#include <climits>
 #include <cerrno>
 #include <algorithm>
 #include <cstring>
 #include "Socket.h"
+#include "SocketOptions.h"
 #include "Reactor.h"
 #include "Future.h"
+#include "FutureUtil.h"
 #include "Packet.h"
 #include "Poolable.h"
 #include "IntrusivePtr.h"
 #include "NetBuffer.h"
+#include "Numa.h"
+#include "BufferLimits.h"
+#include "ConditionVariable.h"
+#include "ReuseportSteering.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+struct ZeroCopyConfig {
+    // 单次 sendmsg 不少于这么多字节才带 MSG_ZEROCOPY：钉页和完成通知有固定开销，
+    // 小块数据直接拷贝更便宜（见 benchmark/benchmark_zerocopy.cpp）
+    static inline size_t threshold = 64 * 1024;
+};
+
+struct ZeroCopyStats {
+    uint64_t sends = 0;      // 带 MSG_ZEROCOPY 成功发出的 sendmsg 次数
+    uint64_t completed = 0;  // 已收到完成通知的次数
+    uint64_t copied = 0;     // 其中内核实际退回了拷贝的次数（例如回环、网卡不支持 scatter-gather）
+};
+
+/**
+ * 零拷贝发送的在途记录
+ * 内核直接引用 Packet 所在的页，完成通知到达之前数据不能被改写或回收，
+ * 所以每次零拷贝 sendmsg 发出的那段 Packet 引用留在这里，收到通知再释放
+ */
+struct ZeroCopyTracker {
+    struct Inflight {
+        uint32_t id;                            // 内核按成功的零拷贝 sendmsg 依次编号
+        Packet data;
+    };
+    uint32_t next_id = 0;
+    std::deque<Inflight> inflight;
+    ZeroCopyStats stats;
+
+    bool empty() const { return inflight.empty(); }
+
+    void hold(Packet sent) {
+        inflight.push_back(Inflight{next_id++, std::move(sent)});
+        ++stats.sends;
+    }
+
+    // 读空 fd 错误队列里的零拷贝完成通知：每条通知覆盖一个编号区间 [ee_info, ee_data]
+    void drain(int fd) {
+        while (true) {
+            char control[CMSG_SPACE(sizeof(struct sock_extended_err)) * 4];
+            struct msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+
+            for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+                bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                               (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+                if (!recverr) continue;
+                auto* ee = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+                if (ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+                complete(ee->ee_info, ee->ee_data, ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+            }
+        }
+    }
+
+    void complete(uint32_t lo, uint32_t hi, bool copied) {
+        uint32_t count = hi - lo + 1;  // 编号是 32 位回绕计数
+        stats.completed += count;
+        if (copied) stats.copied += count;
+        // 通知通常按顺序到达，只需从队头弹出；乱序时在整个队列里查找
+        while (!inflight.empty() && inflight.front().id - lo < count) {
+            inflight.pop_front();
+        }
+        inflight.erase(std::remove_if(inflight.begin(), inflight.end(),
+                           [lo, count](const Inflight& z) { return z.id - lo < count; }),
+                       inflight.end());
+    }
+};
+
+/**
+ * 连接析构时仍有零拷贝数据在途：socket 和在途的 Packet 引用一起转交到这里
+ * fd 保持打开并以 EPOLLERR 注册在 Reactor 上，继续接收完成通知（连接已 shutdown 时，
+ * 内核仍会把发送队列里的数据发完或在重传超时后丢弃，两种情况都会报告完成）；
+ * 全部完成后才摘除、关闭 fd 并释放 buffer，内核不会读到已被复用的内存
+ * 每个 shard 一个，只在本 shard 的 Reactor 线程上使用；shard 线程退出时 Reactor 已先销毁，剩余条目随之关闭
+ */
+class ZeroCopyGraveyard {
+private:
+    struct Entry {
+        Socket socket;
+        ZeroCopyTracker tracker;
+    };
+    Reactor* reactor_ = nullptr;
+    std::unordered_map<int, Entry> entries_;
+
+public:
+    static ZeroCopyGraveyard& local() {
+        static thread_local ZeroCopyGraveyard graveyard;
+        return graveyard;
+    }
+
+    // 调用前 fd 已经从 Reactor 摘除
+    void adopt(Reactor* reactor, Socket socket, ZeroCopyTracker tracker) {
+        int fd = socket.fd();
+        tracker.drain(fd);
+        if (tracker.empty()) return;
+        reactor_ = reactor;
+        entries_.emplace(fd, Entry{std::move(socket), std::move(tracker)});
+        // 边沿触发：注册时错误队列已非空也会立即报告一次
+        reactor_->add(fd, 0, [this, fd](uint32_t) { on_error(fd); });
+    }
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    void on_error(int fd) {
+        auto it = entries_.find(fd);
+        if (it == entries_.end()) return;
+        it->second.tracker.drain(fd);
+        if (!it->second.tracker.empty()) return;
+        // 摘除 handler 会销毁正在执行的这个 lambda，之后不再访问捕获的变量
+        reactor_->remove(fd);
+        entries_.erase(it);
+    }
+};
 
 class TcpConnection : public Poolable<TcpConnection>, public RefCounted<TcpConnection>
 {                    
@@ -24,31 +158,141 @@ private:
     // ── 读状态 ──
     std::deque<NetBuffer*> input_buffers_;
     LocalPtr<Promise<Packet>> pending_read_;
+    size_t read_size_hint_ = NetBuffer::kClassSizes[0];  // 新 buffer 的选级依据，见 drain_socket
+    size_t input_bytes_ = 0;        // 已读入、尚未被 read() 取走的字节
 
     // ── 写状态 ──
-    std::deque<NetBuffer*> output_buffers_;
-    LocalPtr<Promise<ssize_t>> pending_write_;
-    ssize_t total_write_size_ = 0;
+    // 输出队列直接持有调用方 Packet 的引用（不复制），每次 write() / send_file() 一个条目、一个 promise
+    struct OutputEntry {
+        Packet packet;                          // 尚未发出的部分
+        LocalPtr<Promise<ssize_t>> promise;
+        ssize_t total;                          // 全部发出后交给调用方的字节数
+        // 文件条目（send_file）：packet 为空，从 file_offset 起还有 file_remaining 字节
+        int file_fd = -1;
+        off_t file_offset = 0;
+        size_t file_remaining = 0;
+    };
+    std::deque<OutputEntry> output_queue_;
+    static constexpr size_t kMaxIov = IOV_MAX;  // 单次 sendmsg 最多提交的分片数
+    // 输出流模式：本轮迭代内的写入先排队，迭代结束时每个连接统一发送一次
+    bool batch_writes_ = false;
+    bool flush_scheduled_ = false;
+    size_t output_bytes_ = 0;       // 排队尚未发出的字节
+
+    // ── 零拷贝发送 ──
+    // 析构时仍有在途数据则连同 socket 转交给 ZeroCopyGraveyard，等内核报告完成再释放
+    bool zero_copy_ = false;
+    size_t zero_copy_threshold_ = ZeroCopyConfig::threshold;
+    ZeroCopyTracker zc_;
+    ConditionVariable writable_cv_; // until_writable() 的等待者
+
+    // ── 背压 ──
+    // 暂停读取的原因（位掩码），任一原因存在时 EPOLLIN 不在 epoll 中，数据留在内核里
+    enum PauseReason : uint8_t {
+        kInputFull = 1,    // 输入积压超过 input_high
+        kOutputFull = 2,   // 输出积压超过 output_high
+        kShardBudget = 4,  // shard 预算耗尽
+    };
+    ConnectionLimits limits_ = BufferConfig::connection;
+    uint8_t read_paused_ = 0;
 
     // ── 连接状态 ──
     bool closed_ = false;
+    bool peer_eof_ = false;        // 对端已关闭写端：缓冲区里剩余的数据被读走后再关闭
+    bool accepted_;                // 入站连接：计入 reuseport::ShardLoad
     uint32_t current_events_ = 0;  // 当前 epoll 注册的事件掩码
 
+    // ── 停机 ──
+    // 打开期间持有本 shard 的 Gate，Engine::stop 等所有连接关闭后才停止事件循环；
+    // 持有 Gate 的连接串成本 shard 的侵入式链表，stop 时由 close_all_open() 统一关闭
+    Gate::Holder gate_holder_;
+    TcpConnection* open_prev_ = nullptr;
+    TcpConnection* open_next_ = nullptr;
+
+    struct OpenList {
+        TcpConnection* head = nullptr;
+        Reactor* hooked = nullptr;     // 已向哪个 Reactor 注册过 at_stop
+    };
+
     struct PrivateKey {};
 
 public:
 
-    TcpConnection(PrivateKey, Socket&& socket, Reactor* reactor)
-        : socket_(std::move(socket)), reactor_(reactor)
+    TcpConnection(PrivateKey, Socket&& socket, Reactor* reactor, bool accepted)
+        : socket_(std::move(socket)), reactor_(reactor), accepted_(accepted),
+          gate_holder_(reactor->gate().try_hold())
     {
+        if (accepted_) reuseport::ShardLoad::opened();
+        if (gate_holder_) link_open();
     }
 
-    // 工厂方法：创建后立即注册到 epoll（一生一次的 ADD）
+    // 工厂方法：包装 accept 出来的 socket，创建后立即注册到 epoll（一生一次的 ADD）
+    // Engine::stop 开始之后创建的连接拿不到 Gate，直接处于关闭状态
     static LocalPtr<TcpConnection> create(Socket&& socket, Reactor* reactor) {
-        auto conn = make_local<TcpConnection>(
-            PrivateKey{}, std::move(socket), reactor);
-        conn->register_to_reactor();
-        return conn;
+        return make(std::move(socket), reactor, true);
+    }
+
+    // 异步建连：非阻塞 connect 后等 EPOLLOUT，用 SO_ERROR 判断握手结果，成功后与 accept 出来的连接完全相同
+    // 失败或超过 timeout_ms 仍未完成时结果为空指针（Future 没有异常通道）
+    // options 在 connect 之前设置到 socket 上（见 SocketOptions::apply_client）
+    static Future<LocalPtr<TcpConnection>> connect(Reactor* reactor, const std::string& ip, int port,
+                                                   int timeout_ms = 3000,
+                                                   const SocketOptions& options = SocketOptions()) {
+        if (reactor->gate().is_closed()) {
+            return Future<LocalPtr<TcpConnection>>::make_ready(LocalPtr<TcpConnection>());
+        }
+        Socket sock = Socket::create_tcp();
+        options.apply_client(sock);
+        bool connected = false;
+        try {
+            connected = sock.connect(ip.c_str(), port);
+        } catch (const std::exception&) {
+            return Future<LocalPtr<TcpConnection>>::make_ready(LocalPtr<TcpConnection>());
+        }
+        if (connected) {
+            return Future<LocalPtr<TcpConnection>>::make_ready(make(std::move(sock), reactor, false));
+        }
+
+        auto st = make_local<ConnectState>();
+        st->socket = std::move(sock);
+        st->reactor = reactor;
+        st->gate = reactor->gate().hold();
+        // 握手完成（成功或失败）时 socket 变为可写，失败时同时带 EPOLLERR
+        reactor->add(st->socket.fd(), EPOLLOUT, [st](uint32_t) {
+            auto guard = st;  // finish() 会摘除这个 handler
+            guard->finish();
+        });
+        return wait_connected(std::move(st), timeout_ms);
+    }
+
+    // 异步连接 Unix 域 socket（以 '@' 开头的路径为抽象命名空间），结果与 connect 相同
+    // AF_UNIX 的 connect 要么立即完成，要么因对端 backlog 已满返回 EAGAIN 且不留下进行中的连接，
+    // 也没有可等的就绪事件；这种情况每 kUnixRetryMs 重试一次，直到成功、出错或超时
+    static Future<LocalPtr<TcpConnection>> connect_unix(Reactor* reactor, const std::string& path,
+                                                        int timeout_ms = 3000,
+                                                        const SocketOptions& options = SocketOptions()) {
+        if (reactor->gate().is_closed()) {
+            return Future<LocalPtr<TcpConnection>>::make_ready(LocalPtr<TcpConnection>());
+        }
+        Socket sock = Socket::create_unix();
+        options.apply_client(sock);
+        bool connected = false;
+        try {
+            connected = sock.connect_unix(path);
+        } catch (const std::exception&) {
+            return Future<LocalPtr<TcpConnection>>::make_ready(LocalPtr<TcpConnection>());
+        }
+        if (connected) {
+            return Future<LocalPtr<TcpConnection>>::make_ready(make(std::move(sock), reactor, false));
+        }
+
+        auto st = make_local<ConnectState>();
+        st->socket = std::move(sock);
+        st->reactor = reactor;
+        st->gate = reactor->gate().hold();
+        st->unix_path = path;
+        retry_unix(st);
+        return wait_connected(std::move(st), timeout_ms);
     }
 
     // 禁用拷贝和移动
@@ -60,33 +304,89 @@ public:
     ~TcpConnection() {
         if (!closed_) {
             reactor_->remove(socket_.fd());
+            release_gate();
+        }
+        // 清理由于断开连接残留在队列中的 NetBuffer，防止内存池泄漏；
+        // 读入字节的预算随 buffer 的最后一个引用一起归还
+        for (auto buf : input_buffers_) buf->unref();
+        ShardBufferBudget::local().release(output_bytes_);
+        if (accepted_) reuseport::ShardLoad::closed();
+        if (!zc_.empty()) {
+            ZeroCopyGraveyard::local().adopt(reactor_, std::move(socket_), std::move(zc_));
         }
-        // 清理由于断开连接残留在队列中的 NetBuffer，防止内存池泄漏
-        for (auto buf : input_buffers_) delete buf;
-        for (auto buf : output_buffers_) delete buf;
     }
 
+    // 能立即完成的读写返回就绪的 Future（值放在 Future 里），只有真正挂起时才分配 Promise
     Future<Packet> read() {
-        auto promise = LocalPtr<Promise<Packet>>(new Promise<Packet>());
+        if (closed_) return Future<Packet>::make_ready(Packet());
 
-        if (closed_) {
-            promise->set_value(Packet());
-            return promise->get_future();
+        // 对端已关闭写端，但暂停读取期间收到的 EOF 之前可能还有数据留在内核里，先读一次
+        if (peer_eof_ && readable_bytes() == 0 && !read_paused_) {
+            drain_socket();
         }
 
         // 步骤 1: 检查缓冲区
         if (readable_bytes() > 0) {
-            Packet pkt = extract_packet(readable_bytes());
-            promise->set_value(std::move(pkt));
-            return promise->get_future();
+            return Future<Packet>::make_ready(extract_packet(readable_bytes()));
+        }
+
+        // 暂停读取期间不能关闭，恢复读取后由 handle_readable 判断
+        if (closed_ || (peer_eof_ && !read_paused_)) {
+            handle_close();
+            return Future<Packet>::make_ready(Packet());
         }
 
         // 步骤 2: 直接挂起，等待 handle_readable() 来 fulfill
+        auto promise = LocalPtr<Promise<Packet>>(new Promise<Packet>());
         pending_read_ = promise;
         return promise->get_future();
     }
 
     Future<ssize_t> write(Packet p) {
+        if (closed_) return Future<ssize_t>::make_ready(-1);
+        if (p.size() == 0) return Future<ssize_t>::make_ready(0);
+
+        ssize_t total = static_cast<ssize_t>(p.size());
+
+        // 输出流模式下，本轮已经写过（flush 已预约）的连接只排队，迭代结束时合并发送；
+        // 空闲连接的第一次写入仍然立即发出，单个请求的延迟不受影响
+        if (batch_writes_ && flush_scheduled_) {
+            return enqueue_output(std::move(p), total);
+        }
+        if (batch_writes_) schedule_flush();
+
+        // ★ 步骤 1: 队列为空时尝试立即写入（热路径），多个分片用一次 sendmsg 交给内核
+        // 队列里还有数据时必须排在后面，保证字节顺序
+        if (output_queue_.empty()) {
+            while (p.size() > 0) {
+                struct iovec iov[kMaxIov];
+                size_t cnt = p.to_iovec(iov, kMaxIov);
+                bool zero_copy = false;
+                ssize_t n = send_iov(iov, cnt, cnt < p.nr_frags(), &zero_copy);
+                if (n > 0) {
+                    if (zero_copy) zc_.hold(p.slice(0, static_cast<size_t>(n)));
+                    p = p.drop_front(static_cast<size_t>(n));
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;  // 发送缓冲区满了，走步骤 3
+                } else if (errno != EINTR) {
+                    return Future<ssize_t>::make_ready(-1);
+                }
+            }
+
+            // ★ 步骤 2: 全部写完 → 直接返回
+            if (p.size() == 0) return Future<ssize_t>::make_ready(total);
+        }
+
+        // ★ 步骤 3: 剩余部分连同 Packet 的引用一起排队，等 EPOLLOUT 后继续发送
+        auto fut = enqueue_output(std::move(p), total);
+        enable_write();
+        return fut;
+    }
+
+    // 把文件 [offset, offset + len) 经 sendfile 直接从页缓存发到 socket，数据不经过用户态
+    // 和 write() 共用输出队列：前后的 Packet 按调用顺序发出，发送缓冲区满时同样等 EPOLLOUT 续传
+    // file_fd 由调用方持有，Future 完成前不能关闭；结果为发出的字节数（文件比 len 短时提前结束），出错为 -1
+    Future<ssize_t> send_file(int file_fd, off_t offset, size_t len) {
         auto promise = LocalPtr<Promise<ssize_t>>(new Promise<ssize_t>());
 
         if (closed_) {
@@ -94,66 +394,233 @@ public:
             return promise->get_future();
         }
 
-        if (p.size() == 0) {
+        if (len == 0) {
             promise->set_value(0);
             return promise->get_future();
         }
 
-        int fd = socket_.fd();
-        const char* data = p.data();
-        size_t remaining = p.size();
-        ssize_t total = static_cast<ssize_t>(p.size());
+        auto fut = promise->get_future();
+        bool idle = output_queue_.empty();
+        // 文件字节同样计入输出水位和 shard 预算，大文件排队期间照常对读取施加背压
+        charge_output(len);
+        output_queue_.push_back(OutputEntry{Packet(), std::move(promise), static_cast<ssize_t>(len),
+                                            file_fd, offset, len});
 
-        // ★ 步骤 1: 尝试立即写入（热路径）
-        while (remaining > 0) {
-            ssize_t n = ::write(fd, data, remaining);
-            if (n > 0) {
-                data += n;
-                remaining -= n;
-            } else if (n < 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    break;  // 发送缓冲区满了，走步骤 3
-                }
-                promise->set_value(-1);
-                return promise->get_future();
-            }
+        // 与 write() 相同：输出流模式下本轮已经写过的连接只排队，迭代结束时合并发送；
+        // 空闲连接的第一次发送立即开始。队列原本不为空说明已经在等 EPOLLOUT，排在后面即可
+        if (batch_writes_ && flush_scheduled_) return fut;
+        if (batch_writes_) schedule_flush();
+        if (idle) flush_output();
+        return fut;
+    }
+
+    // 带截止时间的读写：超时后取消底层挂起的读/写，结果为 std::nullopt
+    Future<std::optional<Packet>> read(TimePoint deadline) {
+        return with_timeout(deadline, read(), [self = local_from_this()]() {
+            self->cancel_read();
+        });
+    }
+
+    // 超时只取消这一次写入，排在它前后的写入不受影响（见 cancel_write）
+    Future<std::optional<ssize_t>> write(Packet p, TimePoint deadline) {
+        size_t queued = output_queue_.size();
+        auto fut = write(std::move(p));
+        // 没能立即写完的 write() 恰好在队尾追加一个条目
+        LocalPtr<Promise<ssize_t>> entry;
+        if (output_queue_.size() > queued) entry = output_queue_.back().promise;
+        return with_timeout(deadline, std::move(fut), [self = local_from_this(), entry]() {
+            if (entry) self->cancel_write(entry.get());
+        });
+    }
+
+    // 取消挂起的 read()：以空 Packet 完成
+    void cancel_read() {
+        if (pending_read_) {
+            auto p = std::move(pending_read_);
+            p->set_value(Packet());
         }
+    }
 
-        // ★ 步骤 2: 全部写完 → 直接返回
-        if (remaining == 0) {
-            promise->set_value(total);
-            return promise->get_future();
+    // 主动关闭（例如回收 slowloris 连接）：发 FIN，摘除 epoll，完成所有挂起的读写
+    void close() {
+        if (closed_) return;
+        ::shutdown(socket_.fd(), SHUT_RDWR);
+        handle_close();
+    }
+
+    int fd() const { return socket_.fd(); }
+
+    bool is_closed() const { return closed_; }
+
+    // 已读入用户态、还没被 read() 取走的字节
+    size_t buffered_bytes() const { return input_bytes_; }
+
+    // 下一个新接收 buffer 的选级依据：最近每轮读到字节数的滑动平均，见 drain_socket
+    size_t read_size_hint() const { return read_size_hint_; }
+
+    // 已排队、还没交给内核的输出字节（含 send_file 尚未发出的文件字节）
+    size_t queued_output_bytes() const { return output_bytes_; }
+
+    // 输出流模式：适合 HTTP 流水线、RPC 多路复用这类一批请求产生多个响应的场景
+    void set_batch_writes(bool on) { batch_writes_ = on; }
+
+    // 单独调整本连接的水位（例如代理的上游连接需要更大的输出缓冲）
+    void set_limits(const ConnectionLimits& limits) { limits_ = limits; }
+
+    // 大块数据的零拷贝发送：单次 sendmsg 不少于 threshold 字节时带 MSG_ZEROCOPY，更小的照常拷贝
+    // write() 的 Future 仍在数据交给内核后完成；Packet 本身不可变，连接替它保留引用直到内核通知完成
+    // 内核不支持 SO_ZEROCOPY 时返回 false，连接保持普通发送
+    bool set_zero_copy(bool on, size_t threshold = ZeroCopyConfig::threshold) {
+        zero_copy_threshold_ = threshold;
+        if (on == zero_copy_) return true;
+        if (on) {
+            int one = 1;
+            if (::setsockopt(socket_.fd(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) return false;
         }
+        zero_copy_ = on;
+        return true;
+    }
+
+    const ZeroCopyStats& zero_copy_stats() const { return zc_.stats; }
 
-        // ★ 步骤 3: 部分写入 → 分配 NetBuffer 缓存剩余数据
-        while (remaining > 0) {
-            NetBuffer* buf = new NetBuffer(); // 触发 O(1) 分配
-            size_t to_copy = std::min(remaining, buf->writable_bytes());
-            std::memcpy(buf->write_ptr(), data, to_copy);
-            buf->append(to_copy);
-            output_buffers_.push_back(buf);
-            
-            data += to_copy;
-            remaining -= to_copy;
+    // 输出积压未超过 output_high（或已回落到 output_low 以下）
+    bool writable() const { return closed_ || !(read_paused_ & kOutputFull); }
+
+    // 生产者在连续写入大量数据前等待：输出积压回落到 output_low 以下（或连接关闭）时就绪
+    // 不等待也不会出错，只是积压期间连接不再读取新请求
+    // 结果恒为 true：等待者持有连接的引用，条件变量不会先于它销毁
+    Future<bool> until_writable() {
+        return writable_cv_.wait([self = local_from_this()]() { return self->writable(); });
+    }
+
+private:
+
+    static constexpr int kUnixRetryMs = 1;
+
+    // 进行中的 connect：EPOLLOUT（Unix 域为重试定时器）和超时谁先到谁完成，另一方什么也不做
+    struct ConnectState : public RefCounted<ConnectState>, public Poolable<ConnectState> {
+        Socket socket;
+        Reactor* reactor = nullptr;
+        Promise<LocalPtr<TcpConnection>> promise;
+        Gate::Holder gate;         // 握手期间 Engine::stop 等待它完成或超时
+        std::string unix_path;     // 非空：connect_unix，等待期间没有注册到 epoll
+        TimerId retry_timer = 0;
+        bool done = false;
+
+        void finish() {
+            if (done) return;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            ::getsockopt(socket.fd(), SOL_SOCKET, SO_ERROR, &err, &len);
+            // 连接改由 TcpConnection 注册自己的 handler
+            reactor->remove(socket.fd());
+            complete(err == 0);
         }
 
-        total_write_size_ = total;
-        pending_write_ = promise;
-        enable_write();
+        void abort() {
+            if (done) return;
+            if (!unix_path.empty()) {
+                if (retry_timer) reactor->cancel_timer(retry_timer);
+            } else {
+                reactor->remove(socket.fd());
+            }
+            complete(false);
+        }
 
-        return promise->get_future();
+        void complete(bool ok) {
+            done = true;
+            if (!ok) {
+                socket = Socket();
+                promise.set_value(LocalPtr<TcpConnection>());
+                return;
+            }
+            promise.set_value(make(std::move(socket), reactor, false));
+        }
+    };
+
+    // 建连的超时部分：TCP 与 Unix 域共用
+    static Future<LocalPtr<TcpConnection>> wait_connected(LocalPtr<ConnectState> st, int timeout_ms) {
+        auto fut = st->promise.get_future();
+        auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+        return with_timeout(deadline, std::move(fut), [st]() {
+            st->abort();
+        }).then([](std::optional<LocalPtr<TcpConnection>> conn) {
+            return conn ? std::move(*conn) : LocalPtr<TcpConnection>();
+        });
     }
 
-    int fd() const { return socket_.fd(); }
+    static void retry_unix(LocalPtr<ConnectState> st) {
+        st->retry_timer = st->reactor->run_after(kUnixRetryMs, [st]() {
+            st->retry_timer = 0;
+            if (st->done) return;
+            bool connected = false;
+            try {
+                connected = st->socket.connect_unix(st->unix_path);
+            } catch (const std::exception&) {
+                st->complete(false);
+                return;
+            }
+            if (connected) {
+                st->complete(true);
+            } else {
+                retry_unix(st);
+            }
+        });
+    }
 
-private:
+    static LocalPtr<TcpConnection> make(Socket&& socket, Reactor* reactor, bool accepted) {
+        auto conn = make_local<TcpConnection>(
+            PrivateKey{}, std::move(socket), reactor, accepted);
+        conn->register_to_reactor();
+        if (!conn->gate_holder_) conn->close();
+        return conn;
+    }
+
+    // ── 停机辅助 ──
+
+    static OpenList& open_list() {
+        static thread_local OpenList list;
+        return list;
+    }
+
+    void link_open() {
+        OpenList& list = open_list();
+        if (list.hooked != reactor_) {
+            list.hooked = reactor_;
+            reactor_->at_stop([]() { close_all_open(); });
+        }
+        open_next_ = list.head;
+        if (list.head) list.head->open_prev_ = this;
+        list.head = this;
+    }
+
+    // 关闭之后不再有 I/O 在途，此时就 leave，不必等最后一个引用释放
+    void release_gate() {
+        if (!gate_holder_) return;
+        OpenList& list = open_list();
+        if (open_prev_) open_prev_->open_next_ = open_next_;
+        else list.head = open_next_;
+        if (open_next_) open_next_->open_prev_ = open_prev_;
+        open_prev_ = open_next_ = nullptr;
+        gate_holder_ = Gate::Holder();
+    }
+
+    // 挂起的 read() 得到空 Packet、排队的写入以 -1 完成，调用方的循环随之结束并释放连接
+    static void close_all_open() {
+        OpenList& list = open_list();
+        while (list.head) {
+            auto conn = list.head->local_from_this();
+            conn->close();
+        }
+    }
 
     LocalPtr<TcpConnection> local_from_this() {
         return LocalPtr<TcpConnection>(this);
     }
 
     void register_to_reactor() {
-        current_events_ = EPOLLIN;
+        // EPOLLRDHUP：FIN 和最后一段数据同时到达时，短读就返回了，边沿触发不会再为 EOF 通知一次
+        current_events_ = EPOLLIN | EPOLLRDHUP;
         reactor_->add(socket_.fd(), current_events_,
             [self = local_from_this()](uint32_t events) {
                 self->handle_events(events);
@@ -161,23 +628,47 @@ private:
     }
 
     void handle_events(uint32_t events) {
-        if (events & (EPOLLERR | EPOLLHUP)) {
-            handle_close();
+        // handle_close() 会从 Reactor 摘除 handler，连同它持有的引用；
+        // 这里先保活，避免在成员函数执行中途被析构
+        auto guard = local_from_this();
+
+        // 零拷贝的完成通知放在 socket 错误队列里，同样以 EPOLLERR 报告；
+        // 读空错误队列后 SO_ERROR 仍为 0 说明不是真正的错误
+        if (events & EPOLLERR) {
+            if (zero_copy_) zc_.drain(socket_.fd());
+            if (!zero_copy_ || socket_error() != 0) {
+                handle_close();
+                return;
+            }
+        }
+        // 两个方向都已关闭。Unix 域 socket 的对端 shutdown(SHUT_RDWR) / close 也报告为 EPOLLHUP，
+        // 这时同一轮到达的数据仍在接收队列里，先读出来交给 read()，取完后再关闭
+        if (events & EPOLLHUP) {
+            peer_eof_ = true;
+            if (!read_paused_) handle_readable();
+            if (readable_bytes() == 0) handle_close();
             return;
         }
 
-        if (events & EPOLLIN)  handle_readable();
+        if (events & EPOLLRDHUP) peer_eof_ = true;
+        if (events & (EPOLLIN | EPOLLRDHUP) && !read_paused_) handle_readable();
         if (events & EPOLLOUT) handle_writable();
     }
 
     void handle_readable() {
-        drain_socket();
+        bool drained = drain_socket();
 
         if (pending_read_ && readable_bytes() > 0) {
             auto p = std::move(pending_read_);
             Packet pkt = extract_packet(readable_bytes());
             p->set_value(std::move(pkt));
         }
+
+        // 读到 EOF 时不能直接关闭，否则同一轮读进来的数据会被丢掉；
+        // 因水位提前停下时内核里还有数据，恢复读取后会再次触发
+        if (drained && peer_eof_ && readable_bytes() == 0) {
+            handle_close();
+        }
     }
 
     void handle_writable() {
@@ -185,82 +676,263 @@ private:
     }
 
     //  drain_socket() — 直接读入裸内存，告别 vector memset 开销
-    void drain_socket() {
+    //  新 buffer 的大小按本连接最近每轮读到的字节数选级；上一次 read 把 buffer 填满
+    //  说明内核里还有积压，这时用 FIONREAD 查一次积压量，直接选够大的一级
+    //  输入积压或 shard 预算超限时提前停下并暂停读取（返回 false），见 BufferLimits.h
+    bool drain_socket() {
         int fd = socket_.fd();
+        size_t drained = 0;
+        bool backlog = false;
 
         while (true) {
-            // 如果队尾 buffer 写满，或者队列为空，则申请一个新 buffer
+            // 队尾 buffer 已读空且不再被 Packet 引用时从头复用；
+            // 写满或者队列为空，则申请一个新 buffer
+            if (!input_buffers_.empty()) input_buffers_.back()->maybe_rewind();
             if (input_buffers_.empty() || input_buffers_.back()->writable_bytes() == 0) {
-                input_buffers_.push_back(new NetBuffer());
+                size_t want = read_size_hint_;
+                int pending = 0;
+                if (backlog && ::ioctl(fd, FIONREAD, &pending) == 0 && pending > 0) {
+                    want = std::max(want, static_cast<size_t>(pending));
+                }
+                input_buffers_.push_back(NetBuffer::create(NetBuffer::class_for(want)));
             }
 
             NetBuffer* buf = input_buffers_.back();
             size_t requested = buf->writable_bytes();
-            
+
             // 直接传递指向未初始化内存的指针，免去零初始化
             ssize_t n = ::read(fd, buf->write_ptr(), requested);
 
             if (n > 0) {
                 buf->append(n);
+                drained += static_cast<size_t>(n);
+                input_bytes_ += static_cast<size_t>(n);
+                buf->charge(static_cast<size_t>(n));
+                // 按采样率检查收包缓冲区是否落在本 shard 的 NUMA 节点上
+                numa::sample(buf);
 
                 // 内核已空，不必再读
                 if (static_cast<size_t>(n) < requested) {
-                    return;
+                    update_read_hint(drained);
+                    return true;
+                }
+                backlog = true;
+
+                // 积压达到水位：没读完的数据留在内核里，接收窗口收缩后发送方自然减速；
+                // 恢复读取时 EPOLL_CTL_MOD 会重新检查就绪状态，边沿触发也不会漏掉剩余数据
+                if (input_bytes_ >= limits_.input_high) {
+                    update_read_hint(drained);
+                    pause_reading(kInputFull);
+                    return false;
+                }
+                if (ShardBufferBudget::local().exhausted()) {
+                    update_read_hint(drained);
+                    wait_for_budget();
+                    return false;
                 }
                 continue;
             }
 
+            update_read_hint(drained);
+
             if (n == 0) {
-                handle_close();
-                return;
+                peer_eof_ = true;
+                return true;
             }
 
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                return;
+                return true;
             }
 
             handle_close();
-            return;
+            return true;
         }
     }
 
-    //  flush_output() — 消费输出队列
-    void flush_output() {
-        int fd = socket_.fd();
-
-        while (!output_buffers_.empty()) {
-            NetBuffer* buf = output_buffers_.front();
-            ssize_t n = ::write(fd, buf->read_ptr(), buf->readable_bytes());
+    // 每轮读取量的指数滑动平均（权重 1/4）：突发的大请求不会让闲聊连接长期占用大 buffer
+    void update_read_hint(size_t drained) {
+        if (drained == 0) return;
+        read_size_hint_ = (read_size_hint_ * 3 + drained) / 4;
+    }
 
-            if (n > 0) {
-                buf->retrieve(n);
-                // 当前 buffer 写空了，归还给对象池
-                if (buf->readable_bytes() == 0) {
-                    delete buf; 
-                    output_buffers_.pop_front();
+    //  flush_output() — 消费输出队列：每次 sendmsg 跨条目聚集最多 IOV_MAX 个分片，
+    //  遇到文件条目时停下，轮到它时改用 sendfile
+    void flush_output() {
+        while (!output_queue_.empty()) {
+            if (output_queue_.front().file_fd >= 0) {
+                ssize_t n = send_file_chunk(output_queue_.front());
+                if (n > 0) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    enable_write();
+                    return;
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) {
+                    disable_write();
+                    fail_output();
+                    return;
                 }
+                // n == 0：文件提前结束，以实际发出的字节数完成
+                complete_file_entry();
                 continue;
             }
 
-            if (n < 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    return; // 等待下次 EPOLLOUT
-                }
-                
-                disable_write();
-                if (pending_write_) {
-                    auto p = std::move(pending_write_);
-                    p->set_value(-1);
+            struct iovec iov[kMaxIov];
+            size_t cnt = 0;
+            bool more = false;  // 队列里还有这次装不下的分片
+            for (auto& entry : output_queue_) {
+                if (cnt == kMaxIov || entry.file_fd >= 0) {
+                    more = true;
+                    break;
                 }
+                size_t added = entry.packet.to_iovec(iov + cnt, kMaxIov - cnt);
+                if (added < entry.packet.nr_frags()) more = true;
+                cnt += added;
+            }
+
+            bool zero_copy = false;
+            ssize_t n = send_iov(iov, cnt, more, &zero_copy);
+            if (n > 0) {
+                if (zero_copy) zc_.hold(sent_prefix(static_cast<size_t>(n)));
+                consume_output(static_cast<size_t>(n));
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                enable_write(); // 等待下次 EPOLLOUT
                 return;
             }
+            if (errno == EINTR) continue;
+
+            disable_write();
+            fail_output();
+            return;
         }
 
         disable_write();
+    }
 
-        if (pending_write_) {
-            auto p = std::move(pending_write_);
-            p->set_value(total_write_size_);
+    // more：这次调用之后还有数据要发，带 MSG_MORE 让内核把它们拼进同一批报文段，
+    // 效果等同于在这段时间里设置 TCP_CORK，但不需要额外的 setsockopt 系统调用
+    // zero_copy：这次是否以 MSG_ZEROCOPY 发出，是则调用方要保留发出部分的引用
+    ssize_t send_iov(struct iovec* iov, size_t cnt, bool more, bool* zero_copy) {
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = cnt;
+        // MSG_NOSIGNAL：对端已关闭时返回 EPIPE，而不是让进程收到 SIGPIPE
+        int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+        *zero_copy = false;
+
+        if (zero_copy_ && iov_bytes(iov, cnt) >= zero_copy_threshold_) {
+            ssize_t n = ::sendmsg(socket_.fd(), &msg, flags | MSG_ZEROCOPY);
+            if (n > 0) *zero_copy = true;
+            // ENOBUFS：未完成的通知超出 optmem_max，这一次退回普通拷贝
+            if (n >= 0 || errno != ENOBUFS) return n;
+        }
+        return ::sendmsg(socket_.fd(), &msg, flags);
+    }
+
+    static size_t iov_bytes(const struct iovec* iov, size_t cnt) {
+        size_t total = 0;
+        for (size_t i = 0; i < cnt; ++i) total += iov[i].iov_len;
+        return total;
+    }
+
+    // 输出队列开头 n 字节对应的 Packet（共享引用，不复制），供零拷贝发送保留
+    Packet sent_prefix(size_t n) const {
+        Packet sent;
+        for (auto& entry : output_queue_) {
+            if (n == 0) break;
+            size_t len = std::min(n, entry.packet.size());
+            sent.append(entry.packet.slice(0, len));
+            n -= len;
+        }
+        return sent;
+    }
+
+    int socket_error() const {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (::getsockopt(socket_.fd(), SOL_SOCKET, SO_ERROR, &err, &len) != 0) return errno;
+        return err;
+    }
+
+    // 文件条目的一次 sendfile，内核推进 file_offset；发完时完成该条目
+    ssize_t send_file_chunk(OutputEntry& entry) {
+        ssize_t n = ::sendfile(socket_.fd(), entry.file_fd, &entry.file_offset, entry.file_remaining);
+        if (n > 0) {
+            entry.file_remaining -= static_cast<size_t>(n);
+            release_output(static_cast<size_t>(n));
+            if (entry.file_remaining == 0) complete_file_entry();
+        }
+        return n;
+    }
+
+    void complete_file_entry() {
+        OutputEntry& entry = output_queue_.front();
+        auto promise = std::move(entry.promise);
+        ssize_t sent = entry.total - static_cast<ssize_t>(entry.file_remaining);
+        release_output(entry.file_remaining);   // 文件提前结束时没发出的部分
+        output_queue_.pop_front();
+        promise->set_value(sent);
+    }
+
+    void schedule_flush() {
+        flush_scheduled_ = true;
+        reactor_->at_iteration_end([self = local_from_this()]() {
+            self->flush_scheduled_ = false;
+            // 正在等 EPOLLOUT 时由 handle_writable 继续发送
+            if (!self->closed_ && !(self->current_events_ & EPOLLOUT)) {
+                self->flush_output();
+            }
+        });
+    }
+
+    // 已发出 n 字节：完整发出的条目依次完成，最后一个条目只剩未发出的部分
+    void consume_output(size_t n) {
+        while (n > 0 && !output_queue_.empty()) {
+            OutputEntry& entry = output_queue_.front();
+            if (n < entry.packet.size()) {
+                entry.packet = entry.packet.drop_front(n);
+                release_output(n);
+                return;
+            }
+            n -= entry.packet.size();
+            release_output(entry.packet.size());
+            auto promise = std::move(entry.promise);
+            ssize_t total = entry.total;
+            output_queue_.pop_front();
+            promise->set_value(total);
+        }
+    }
+
+    // 取消 promise 对应的输出条目，以 -1 完成；已经完成的条目什么也不做
+    // 一个字节都还没发出的条目直接从队列中摘除，其余写入照常发送；
+    // 已经部分发出的条目（只可能是队首）无法撤回，剩余部分也不能跳过，否则字节流错位，只能关闭连接
+    void cancel_write(Promise<ssize_t>* promise) {
+        auto it = std::find_if(output_queue_.begin(), output_queue_.end(), [promise](const OutputEntry& e) {
+            return e.promise.get() == promise;
+        });
+        if (it == output_queue_.end()) return;
+        bool started = it->file_fd >= 0 ? it->file_remaining < static_cast<size_t>(it->total)
+                                        : it->packet.size() < static_cast<size_t>(it->total);
+        if (started) {
+            close();
+            return;
+        }
+        auto cancelled = std::move(it->promise);
+        release_output(it->file_fd >= 0 ? it->file_remaining : it->packet.size());
+        output_queue_.erase(it);
+        if (output_queue_.empty()) disable_write();
+        cancelled->set_value(-1);
+    }
+
+    // 丢弃所有尚未发出的数据，挂起的 write() 全部以 -1 完成
+    void fail_output() {
+        std::deque<OutputEntry> failed;
+        failed.swap(output_queue_);
+        release_output(output_bytes_);
+        for (auto& entry : failed) {
+            entry.promise->set_value(-1);
         }
     }
 
@@ -288,47 +960,92 @@ private:
             auto p = std::move(pending_read_);
             p->set_value(Packet());
         }
-        if (pending_write_) {
-            auto p = std::move(pending_write_);
-            p->set_value(-1);
+        fail_output();
+        writable_cv_.broadcast();
+        release_gate();
+    }
+
+    // ── 背压辅助 ──
+
+    void pause_reading(PauseReason reason) {
+        bool was_paused = read_paused_ != 0;
+        read_paused_ |= reason;
+        if (!was_paused && !closed_) {
+            current_events_ &= ~EPOLLIN;
+            reactor_->modify_events(socket_.fd(), current_events_);
         }
     }
 
-    // ── Buffer 辅助提取逻辑 ──
+    void resume_reading(PauseReason reason) {
+        if (!(read_paused_ & reason)) return;
+        read_paused_ &= ~reason;
+        if (!read_paused_ && !closed_) {
+            current_events_ |= EPOLLIN;
+            reactor_->modify_events(socket_.fd(), current_events_);
+        }
+    }
 
-    // 获取当前所有 buffer 加起来的可读总长度
-    size_t readable_bytes() const {
-        size_t total = 0;
-        for (auto buf : input_buffers_) {
-            total += buf->readable_bytes();
+    // 预算回落后由 ShardBufferBudget 回调；持有引用，等待期间连接不会被析构
+    void wait_for_budget() {
+        if (read_paused_ & kShardBudget) return;
+        pause_reading(kShardBudget);
+        ShardBufferBudget::local().wait([self = local_from_this()]() {
+            self->resume_reading(kShardBudget);
+        });
+    }
+
+    // 没能立即写完的部分排进输出队列，Promise 只在这里分配
+    Future<ssize_t> enqueue_output(Packet p, ssize_t total) {
+        auto promise = LocalPtr<Promise<ssize_t>>(new Promise<ssize_t>());
+        auto fut = promise->get_future();
+        charge_output(p.size());
+        output_queue_.push_back(OutputEntry{std::move(p), std::move(promise), total});
+        return fut;
+    }
+
+    void charge_output(size_t n) {
+        output_bytes_ += n;
+        ShardBufferBudget::local().charge(n);
+        if (output_bytes_ >= limits_.output_high) pause_reading(kOutputFull);
+    }
+
+    void release_output(size_t n) {
+        output_bytes_ -= n;
+        ShardBufferBudget::local().release(n);
+        if ((read_paused_ & kOutputFull) && output_bytes_ <= limits_.output_low) {
+            resume_reading(kOutputFull);
+            writable_cv_.broadcast();
         }
-        return total;
     }
 
-    // 组装并提取跨越多个 NetBuffer 的离散数据为一个连续的 Packet
+    // ── Buffer 辅助提取逻辑 ──
+
+    // 当前所有 buffer 加起来的可读总长度
+    size_t readable_bytes() const { return input_bytes_; }
+
+    // 零拷贝提取：每个 NetBuffer 中的可读数据成为 Packet 的一个分片，直接引用接收缓冲区
+    // 读完的 buffer 交出连接的引用，等最后一个分片释放后再回到对象池；
+    // 队尾 buffer 还有空间时保留在队列里，后续数据继续写在已交出数据的后面
     Packet extract_packet(size_t len) {
-        if (len == 0) return Packet();
-        
-        Packet pkt(len); // 底层只会 new char[size]，不会 memset
-        char* dest = pkt.data();
+        Packet pkt;
         size_t remaining = len;
 
         while (remaining > 0 && !input_buffers_.empty()) {
             NetBuffer* buf = input_buffers_.front();
-            size_t to_copy = std::min(remaining, buf->readable_bytes());
-            
-            std::memcpy(dest, buf->read_ptr(), to_copy);
-            buf->retrieve(to_copy);
-            
-            dest += to_copy;
-            remaining -= to_copy;
-
-            // 块数据被读完，安全回收
-            if (buf->readable_bytes() == 0) {
-                delete buf;
+            size_t n = std::min(remaining, buf->readable_bytes());
+            pkt.append(buf->take(n));
+            remaining -= n;
+            input_bytes_ -= n;
+
+            if (buf->readable_bytes() == 0 &&
+                (buf->writable_bytes() == 0 || input_buffers_.size() > 1)) {
                 input_buffers_.pop_front();
+                buf->unref();
             }
         }
+        if ((read_paused_ & kInputFull) && input_bytes_ <= limits_.input_low) {
+            resume_reading(kInputFull);
+        }
         return pkt;
     }
 };
\ No newline at end of file
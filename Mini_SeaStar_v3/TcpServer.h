@@ -3,8 +3,11 @@
 #include "Reactor.h"
 #include "Socket.h"
 #include "Future.h"
+#include "ReuseportSteering.h"
+#include "SocketOptions.h"
 #include <iostream>
 #include <memory>
+#include <string>
 
 class TcpServer {
 private:
@@ -12,23 +15,119 @@ private:
     Reactor* reactor_;
 
     std::function<void(Socket)> new_connection_callback_;
+    std::string unix_path_;  // listen_unix 的文件系统路径，析构时删除
+
+    // reuseport 分流（见 ReuseportSteering.h）
+    reuseport::Steering steering_ = reuseport::Steering::kHash;
+    int shard_ = 0;
+    int nr_shards_ = 1;
+
+    SocketOptions options_;
 
 public:
     TcpServer(Reactor* reactor) : reactor_(reactor) {}
 
+    ~TcpServer() {
+        if (!unix_path_.empty()) ::unlink(unix_path_.c_str());
+    }
+
     void set_connection_handler(std::function<void(Socket)> cb) {
         new_connection_callback_ = std::move(cb);
     }
 
+    // 在 listen 之前调用：shard 为本 shard 编号，nr_shards 为监听同一端口的 shard 总数
+    // 非 kHash 模式要求 0..nr_shards-1 的每个 shard 都 listen 同一端口；某个 shard 失败或迟迟不 listen 时
+    // 其余 shard 最多等 reuseport::kJoinTimeout，然后整组退回哈希分流
+    // listen 必须在 Engine::run 的 user_main 中调用（事件循环开始之前），之后调用只能得到哈希分流
+    void set_steering(reuseport::Steering mode, int shard, int nr_shards) {
+        steering_ = mode;
+        shard_ = shard;
+        nr_shards_ = nr_shards;
+    }
+
+    // 在 listen 之前调用：选项设置在监听 socket 上，由 accept 出来的连接继承（见 SocketOptions.h）
+    void set_options(const SocketOptions& options) {
+        options_ = options;
+    }
+
     void listen(int port) {
         listen_sock_ = std::make_unique<Socket>(Socket::create_tcp());
         listen_sock_->set_reuse_addr(true);
         listen_sock_->set_reuse_port(true);
-        listen_sock_->bind(port);
-        listen_sock_->listen();
+        options_.apply_listener(*listen_sock_);
+
+        if (steering_ != reuseport::Steering::kHash && reactor_->running()) {
+            // 按序加入要阻塞等待其他 shard，事件循环里不能这样做
+            std::cerr << "reuseport: listen() after the reactor started, falling back to hash" << std::endl;
+        }
+        if (steering_ == reuseport::Steering::kHash || reactor_->running()) {
+            listen_sock_->bind(port);
+            listen_sock_->listen();
+        } else {
+            // bind 也放在轮次内：bind 失败同样要让出轮次
+            bool ordered = reuseport::join_in_order(port, shard_, nr_shards_, [this, port]() {
+                listen_sock_->bind(port);
+                listen_sock_->listen();
+            });
+            if (ordered) {
+                attach_steering();
+            } else {
+                std::cerr << "reuseport: shards did not join in order, falling back to hash" << std::endl;
+            }
+        }
 
         std::cout << "Server listening on port " << port << "..." << std::endl;
 
+        register_listener();
+    }
+
+    // Unix 域 socket 监听：accept 出来的 Socket 与 TCP 的一样交给 TcpConnection
+    // AF_UNIX 没有 SO_REUSEPORT 分流，每个 shard 监听自己的路径（见 shard_path），
+    // 客户端按路径选择 shard；路径以 '@' 开头时使用抽象命名空间
+    void listen_unix(const std::string& path) {
+        listen_sock_ = std::make_unique<Socket>(Socket::create_unix());
+        listen_sock_->bind_unix(path);
+        listen_sock_->listen();
+        if (!Socket::is_abstract(path)) unix_path_ = path;
+
+        std::cout << "Server listening on " << path << "..." << std::endl;
+
+        register_listener();
+    }
+
+    // 每个 shard 一个监听路径：<base>.<shard>
+    static std::string shard_path(const std::string& base, int shard) {
+        return base + "." + std::to_string(shard);
+    }
+
+private:
+    void attach_steering() {
+        int fd = listen_sock_->fd();
+        if (steering_ == reuseport::Steering::kIncomingCpu) {
+            // 同时声明本 socket 属于哪个 CPU：没有 BPF 程序时，较新的内核也会优先选 CPU 匹配的 socket
+            int cpu = shard_;
+            ::setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+            // 程序作用于整个组，由最后一个加入的 shard 挂载
+            if (shard_ == nr_shards_ - 1 && !reuseport::attach_incoming_cpu(fd, nr_shards_)) {
+                std::cerr << "reuseport: CBPF attach failed, falling back to hash" << std::endl;
+            }
+            return;
+        }
+
+        reuseport::LoadTable* table = reuseport::LoadTable::get(nr_shards_);
+        if (!table) {
+            std::cerr << "reuseport: BPF map unavailable, falling back to hash" << std::endl;
+            return;
+        }
+        reuseport::ShardLoad::table = table;
+        reuseport::ShardLoad::shard = shard_;
+        table->publish(shard_, reuseport::ShardLoad::connections);
+        if (shard_ == nr_shards_ - 1 && !reuseport::attach_least_loaded(fd, table)) {
+            std::cerr << "reuseport: eBPF attach failed, falling back to hash" << std::endl;
+        }
+    }
+
+    void register_listener() {
         int fd = listen_sock_->fd();
 
         // 用新的 add 接口：handler 接收 uint32_t events 参数
@@ -39,7 +138,6 @@ public:
         });
     }
 
-private:
     void handle_accept() {
         // 循环 accept 直到 EAGAIN（ET 模式要求 drain）
         while (true) {
@@ -47,6 +145,8 @@ private:
             if (client_sock.fd() < 0) {
                 break;  // EAGAIN，没有更多连接了
             }
+            // Engine::stop 已关闭本 shard 的 Gate：正在退出，新连接直接关闭
+            if (reactor_->gate().is_closed()) continue;
             if (new_connection_callback_) {
                 new_connection_callback_(std::move(client_sock));
             } else {
@@ -0,0 +1,395 @@
+#pragma once
+#include <deque>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include "Socket.h"
+#include "Reactor.h"
+#include "Future.h"
+#include "Packet.h"
+#include "IntrusivePtr.h"
+#include "BufferLimits.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+/**
+ * UdpChannel：跑在同一个 Reactor 上的 UDP 收发
+ * 每个 shard 用 SO_REUSEPORT 绑定同一个端口，内核按四元组哈希把报文分给各个 shard
+ * 接收：一次 recvmmsg 收一批报文到预先分配的池化 buffer，每个报文成为一个 Packet（不复制）；
+ *      开启 GRO 时内核把同一条流的连续报文合并成一次接收，这里再按段长切片还原
+ *      只用了 buffer 一小部分的报文复制到刚好大小的 Packet，buffer 留给下一批，
+ *      排队的小报文不会各自钉住一整个接收 buffer；排队字节计入 ShardBufferBudget
+ * 发送：send() 只入队，本轮迭代结束时用一次 sendmmsg 发出整批；带 segment_size 的大 Packet
+ *      交给内核做 GSO（UDP_SEGMENT），一次系统调用发出多个等长报文
+ */
+
+struct Datagram {
+    Packet data;
+    sockaddr_in peer{};
+};
+
+struct UdpOptions {
+    size_t max_datagram = 2048;     // 不开 GRO 时每个接收 buffer 的大小，更长的报文被截断并丢弃
+    bool gro = false;               // 开启后接收 buffer 为 64KB，容纳内核合并后的报文
+    size_t rx_queue_limit = 4096;   // 已收到、还没被 receive() 取走的报文上限，超过后暂停读取
+    size_t rx_queue_bytes = 1 << 20;  // 同上，按报文字节计
+    size_t tx_queue_limit = 4096;   // 待发送的报文上限，超过后新报文直接丢弃
+};
+
+struct UdpStats {
+    uint64_t rx_datagrams = 0;
+    uint64_t rx_syscalls = 0;
+    uint64_t rx_truncated = 0;      // 超过 max_datagram 被丢弃的报文
+    uint64_t tx_datagrams = 0;      // 按 sendmmsg 的消息计，GSO 的一条消息可能是多个报文
+    uint64_t tx_syscalls = 0;
+    uint64_t tx_dropped = 0;        // 发送队列满或发送出错而丢弃的报文
+};
+
+class UdpChannel : public RefCounted<UdpChannel>
+{
+private:
+    static constexpr size_t kBatch = 32;        // 每次 recvmmsg / sendmmsg 的消息数
+    static constexpr size_t kMaxIovPerMsg = 8;  // 发送时一条消息最多的分片数，更多时先拼成连续内存
+    static constexpr size_t kGroBufferSize = 65536;
+    // 接收长度不超过 buffer 的 1/kCopyRatio 时复制出来：排队报文钉住的内存最多是报文字节的 kCopyRatio 倍
+    static constexpr size_t kCopyRatio = 4;
+
+    Socket socket_;
+    Reactor* reactor_;
+    UdpOptions options_;
+    uint32_t current_events_ = 0;
+    bool closed_ = false;
+
+    // ── 接收 ──
+    Packet rx_slots_[kBatch];                   // 下一次 recvmmsg 的接收 buffer，用掉的才重新分配
+    std::deque<Datagram> rx_queue_;
+    size_t rx_bytes_ = 0;                       // rx_queue_ 中的报文字节数，同时计入 ShardBufferBudget
+    std::deque<LocalPtr<Promise<Datagram>>> pending_receives_;  // 多个 receive() 同时挂起时按调用顺序交付
+    // 暂停读取的原因（位掩码），任一原因存在时 EPOLLIN 不在 epoll 中
+    enum PauseReason : uint8_t {
+        kQueueFull = 1,    // 接收队列达到 rx_queue_limit / rx_queue_bytes
+        kShardBudget = 2,  // shard 预算耗尽
+    };
+    uint8_t rx_paused_ = 0;
+
+    // ── 发送 ──
+    struct TxEntry {
+        Packet data;
+        sockaddr_in to;
+        uint16_t segment_size;                  // 非 0 时由内核按这个长度切成多个报文
+    };
+    std::deque<TxEntry> tx_queue_;
+    bool flush_scheduled_ = false;
+
+    UdpStats stats_;
+
+    struct PrivateKey {};
+
+public:
+    UdpChannel(PrivateKey, Socket&& socket, Reactor* reactor, const UdpOptions& options)
+        : socket_(std::move(socket)), reactor_(reactor), options_(options)
+    {
+        for (auto& slot : rx_slots_) slot = Packet(rx_buffer_size());
+    }
+
+    // 在当前 shard 绑定 port（0 表示由内核选择临时端口，用作客户端）
+    // 多个 shard 绑定同一端口时依靠 SO_REUSEPORT 分流；绑定失败抛出 std::runtime_error
+    static LocalPtr<UdpChannel> bind(Reactor* reactor, int port, const UdpOptions& options = UdpOptions()) {
+        Socket sock = Socket::create_udp();
+        if (port != 0) {
+            sock.set_reuse_addr(true);
+            sock.set_reuse_port(true);
+        }
+        sock.bind(port);
+        if (options.gro) {
+            int one = 1;
+            ::setsockopt(sock.fd(), SOL_UDP, UDP_GRO, &one, sizeof(one));
+        }
+        auto ch = make_local<UdpChannel>(PrivateKey{}, std::move(sock), reactor, options);
+        ch->register_to_reactor();
+        return ch;
+    }
+
+    UdpChannel(const UdpChannel&) = delete;
+    UdpChannel& operator=(const UdpChannel&) = delete;
+
+    ~UdpChannel() {
+        if (!closed_) reactor_->remove(socket_.fd());
+        ShardBufferBudget::local().release(rx_bytes_);
+    }
+
+    // 取下一个报文；已关闭时得到空 Packet（长度为 0 的报文在接收时即被丢弃，不会与之混淆）
+    // 可以同时挂起多个 receive()，报文按调用顺序交付
+    Future<Datagram> receive() {
+        if (!rx_queue_.empty()) return Future<Datagram>::make_ready(pop_rx());
+        if (closed_) return Future<Datagram>::make_ready(Datagram());
+        auto promise = LocalPtr<Promise<Datagram>>(new Promise<Datagram>());
+        pending_receives_.push_back(promise);
+        return promise->get_future();
+    }
+
+    // 入队，本轮迭代结束时批量发出；segment_size 非 0 时 data 按该长度切成多个报文（GSO）
+    // UDP 不保证送达，队列满或内核拒绝时只计入 stats().tx_dropped
+    void send(const sockaddr_in& to, Packet data, uint16_t segment_size = 0) {
+        if (closed_ || tx_queue_.size() >= options_.tx_queue_limit) {
+            ++stats_.tx_dropped;
+            return;
+        }
+        tx_queue_.push_back(TxEntry{std::move(data), to, segment_size});
+        if (!flush_scheduled_ && !(current_events_ & EPOLLOUT)) schedule_flush();
+    }
+
+    void close() {
+        if (closed_) return;
+        closed_ = true;
+        reactor_->remove(socket_.fd());
+        tx_queue_.clear();
+        std::deque<LocalPtr<Promise<Datagram>>> waiters;
+        waiters.swap(pending_receives_);
+        for (auto& p : waiters) p->set_value(Datagram());
+    }
+
+    // 实际绑定的端口（bind 时传 0 的客户端用它得知内核分配的端口）
+    int local_port() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        ::getsockname(socket_.fd(), reinterpret_cast<sockaddr*>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    int fd() const { return socket_.fd(); }
+    const UdpStats& stats() const { return stats_; }
+
+private:
+    LocalPtr<UdpChannel> local_from_this() {
+        return LocalPtr<UdpChannel>(this);
+    }
+
+    size_t rx_buffer_size() const {
+        return options_.gro ? kGroBufferSize : options_.max_datagram;
+    }
+
+    void register_to_reactor() {
+        current_events_ = EPOLLIN;
+        reactor_->add(socket_.fd(), current_events_,
+            [self = local_from_this()](uint32_t events) {
+                self->handle_events(events);
+            });
+    }
+
+    void handle_events(uint32_t events) {
+        auto guard = local_from_this();
+        if (events & EPOLLIN) handle_readable();
+        if ((events & EPOLLOUT) && !closed_) flush_tx();
+    }
+
+    //  handle_readable() — 边沿触发：一批批 recvmmsg 直到 EAGAIN，或者接收队列达到上限
+    void handle_readable() {
+        while (!closed_) {
+            if (rx_queue_.size() >= options_.rx_queue_limit || rx_bytes_ >= options_.rx_queue_bytes) {
+                pause_reading(kQueueFull);
+                break;
+            }
+            if (ShardBufferBudget::local().exhausted()) {
+                wait_for_budget();
+                break;
+            }
+
+            struct mmsghdr msgs[kBatch];
+            struct iovec iov[kBatch];
+            sockaddr_in peers[kBatch];
+            alignas(struct cmsghdr) char control[kBatch][CMSG_SPACE(sizeof(int))];
+            std::memset(msgs, 0, sizeof(msgs));
+            for (size_t i = 0; i < kBatch; ++i) {
+                const Fragment& f = rx_slots_[i].fragment(0);
+                iov[i] = {f.data(), f.size};
+                msgs[i].msg_hdr.msg_name = &peers[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(peers[i]);
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                if (options_.gro) {
+                    msgs[i].msg_hdr.msg_control = control[i];
+                    msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+                }
+            }
+
+            int n = ::recvmmsg(socket_.fd(), msgs, kBatch, MSG_DONTWAIT, nullptr);
+            if (n <= 0) break;  // EAGAIN：已读空
+            ++stats_.rx_syscalls;
+
+            for (int i = 0; i < n; ++i) {
+                size_t len = msgs[i].msg_len;
+                if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    ++stats_.rx_truncated;
+                    continue;  // buffer 没有被交出去，下一批继续用
+                }
+                if (len == 0) continue;
+                size_t segment = gro_segment_size(msgs[i].msg_hdr);
+                if (len * kCopyRatio <= rx_buffer_size()) {
+                    deliver(Packet(static_cast<const char*>(iov[i].iov_base), len), len, segment, peers[i]);
+                    continue;  // buffer 留在原位，下一批继续用
+                }
+                Packet buf = std::move(rx_slots_[i]);
+                rx_slots_[i] = Packet(rx_buffer_size());
+                deliver(buf, len, segment, peers[i]);
+            }
+
+            if (static_cast<size_t>(n) < kBatch) break;
+        }
+        fulfill_pending();
+    }
+
+    // GRO 合并后的接收：控制消息里给出原始报文的段长，没有则是普通的单个报文
+    static size_t gro_segment_size(struct msghdr& hdr) {
+        if (!hdr.msg_control) return 0;
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                int size;
+                std::memcpy(&size, CMSG_DATA(cm), sizeof(size));
+                return static_cast<size_t>(size);
+            }
+        }
+        return 0;
+    }
+
+    // 一次接收的数据按段长切成多个报文，各自引用同一个 buffer
+    void deliver(const Packet& buf, size_t len, size_t segment, const sockaddr_in& peer) {
+        if (segment == 0 || segment >= len) segment = len;
+        for (size_t off = 0; off < len; off += segment) {
+            rx_queue_.push_back(Datagram{buf.slice(off, std::min(segment, len - off)), peer});
+            ++stats_.rx_datagrams;
+        }
+        rx_bytes_ += len;
+        ShardBufferBudget::local().charge(len);
+    }
+
+    Datagram pop_rx() {
+        Datagram d = std::move(rx_queue_.front());
+        rx_queue_.pop_front();
+        rx_bytes_ -= d.data.size();
+        ShardBufferBudget::local().release(d.data.size());
+        maybe_resume_reading();
+        return d;
+    }
+
+    void fulfill_pending() {
+        while (!pending_receives_.empty() && !rx_queue_.empty()) {
+            auto p = std::move(pending_receives_.front());
+            pending_receives_.pop_front();
+            p->set_value(pop_rx());
+        }
+    }
+
+    // 暂停读取时从 epoll 摘掉 EPOLLIN，报文留在内核的接收缓冲区里（满了由内核丢弃）；
+    // 恢复时 EPOLL_CTL_MOD 会重新检查就绪状态
+    void pause_reading(PauseReason reason) {
+        bool was_paused = rx_paused_ != 0;
+        rx_paused_ |= reason;
+        if (!was_paused && !closed_) {
+            current_events_ &= ~EPOLLIN;
+            reactor_->modify_events(socket_.fd(), current_events_);
+        }
+    }
+
+    void resume_reading(PauseReason reason) {
+        if (!(rx_paused_ & reason)) return;
+        rx_paused_ &= ~reason;
+        if (!rx_paused_ && !closed_) {
+            current_events_ |= EPOLLIN;
+            reactor_->modify_events(socket_.fd(), current_events_);
+        }
+    }
+
+    // 接收队列取走一半后恢复
+    void maybe_resume_reading() {
+        if (rx_queue_.size() > options_.rx_queue_limit / 2 || rx_bytes_ > options_.rx_queue_bytes / 2) return;
+        resume_reading(kQueueFull);
+    }
+
+    // 预算回落后由 ShardBufferBudget 回调；持有引用，等待期间 UdpChannel 不会被析构
+    void wait_for_budget() {
+        if (rx_paused_ & kShardBudget) return;
+        pause_reading(kShardBudget);
+        ShardBufferBudget::local().wait([self = local_from_this()]() {
+            self->resume_reading(kShardBudget);
+        });
+    }
+
+    void schedule_flush() {
+        flush_scheduled_ = true;
+        reactor_->at_iteration_end([self = local_from_this()]() {
+            self->flush_scheduled_ = false;
+            if (!self->closed_ && !(self->current_events_ & EPOLLOUT)) self->flush_tx();
+        });
+    }
+
+    //  flush_tx() — 每次 sendmmsg 发出队头最多 kBatch 条消息
+    void flush_tx() {
+        while (!tx_queue_.empty()) {
+            struct mmsghdr msgs[kBatch];
+            struct iovec iov[kBatch][kMaxIovPerMsg];
+            alignas(struct cmsghdr) char control[kBatch][CMSG_SPACE(sizeof(uint16_t))];
+            std::memset(msgs, 0, sizeof(msgs));
+
+            size_t cnt = std::min(kBatch, tx_queue_.size());
+            for (size_t i = 0; i < cnt; ++i) {
+                TxEntry& e = tx_queue_[i];
+                if (e.data.nr_frags() > kMaxIovPerMsg) e.data.linearize();
+                struct msghdr& hdr = msgs[i].msg_hdr;
+                hdr.msg_name = &e.to;
+                hdr.msg_namelen = sizeof(e.to);
+                hdr.msg_iov = iov[i];
+                hdr.msg_iovlen = e.data.to_iovec(iov[i], kMaxIovPerMsg);
+                if (e.segment_size > 0) {
+                    hdr.msg_control = control[i];
+                    hdr.msg_controllen = sizeof(control[i]);
+                    struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+                    cm->cmsg_level = SOL_UDP;
+                    cm->cmsg_type = UDP_SEGMENT;
+                    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                    std::memcpy(CMSG_DATA(cm), &e.segment_size, sizeof(uint16_t));
+                }
+            }
+
+            int n = ::sendmmsg(socket_.fd(), msgs, static_cast<unsigned>(cnt), MSG_NOSIGNAL);
+            if (n > 0) {
+                ++stats_.tx_syscalls;
+                stats_.tx_datagrams += static_cast<uint64_t>(n);
+                tx_queue_.erase(tx_queue_.begin(), tx_queue_.begin() + n);
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                enable_write();
+                return;
+            }
+            if (errno == EINTR) continue;
+            // 第一条消息被拒绝（例如超过 MTU 的 EMSGSIZE、ICMP 带回的 ECONNREFUSED）：丢掉它继续
+            tx_queue_.pop_front();
+            ++stats_.tx_dropped;
+        }
+        disable_write();
+    }
+
+    void enable_write() {
+        if (!(current_events_ & EPOLLOUT)) {
+            current_events_ |= EPOLLOUT;
+            reactor_->modify_events(socket_.fd(), current_events_);
+        }
+    }
+
+    void disable_write() {
+        if (current_events_ & EPOLLOUT) {
+            current_events_ &= ~EPOLLOUT;
+            reactor_->modify_events(socket_.fd(), current_events_);
+        }
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Reactor.h"
+#include "Future.h"
+#include "Semaphore.h"
+#include "SocketOptions.h"
+#include "TcpConnection.h"
+
+struct UpstreamOptions {
+    size_t max_connections = 64;        // 同时借出（含正在建连）的连接数上限，超出的 acquire() 按 FIFO 排队
+    size_t max_idle = 16;               // 最多保留的空闲连接数
+    int connect_timeout_ms = 1000;
+    int idle_timeout_ms = 30000;        // 空闲超过这么久就关闭，应小于上游服务器的 keep-alive 超时
+    int health_check_interval_ms = 1000;
+    SocketOptions socket = SocketOptions::low_latency();  // 只有客户端相关的选项生效
+};
+
+// Unix 域 socket 上游（本机 sidecar / 代理），以 '@' 开头的路径为抽象命名空间
+struct UnixEndpoint {
+    std::string path;
+};
+
+struct UpstreamStats {
+    uint64_t connects = 0;          // 新建连接次数
+    uint64_t connect_failures = 0;  // 其中失败或超时的次数
+    uint64_t reused = 0;            // 直接复用空闲连接的次数
+    uint64_t evicted = 0;           // 健康检查或借出前检查淘汰的空闲连接数
+};
+
+/**
+ * 单个上游（ip:port 或 Unix 域 socket 路径）的 shard 本地连接池
+ * 每个 shard 各建一个，连接只在本 shard 上建立和复用，请求上游不跨核，复用的连接也不再握手
+ *
+ *   acquire() 拿到一条可用连接：优先复用最近归还的空闲连接，没有就新建；连接数达到上限时排队
+ *   release(conn, reusable) 归还：响应完整读完、可以继续 keep-alive 时 reusable 为 true，
+ *   否则（出错、协议要求关闭、响应没读完）直接关闭
+ *
+ * 健康检查不额外发系统调用：空闲连接仍注册在 Reactor 上，对端 FIN / RST 会让它进入关闭状态，
+ * 空闲期间收到的数据（不属于任何请求）说明连接已经错位；定时检查与借出前检查都淘汰这两类连接，
+ * 以及空闲超过 idle_timeout_ms 的连接
+ *
+ * 与 TcpServer 一样在 engine.run 里创建；Reactor 退出前调用 stop() 关闭空闲连接，
+ * 排队中的 acquire() 随之得到空指针；池销毁后才完成的建连直接关闭，不再访问池
+ * 注意：不是线程安全的，只能在创建它的 shard 上使用
+ */
+class UpstreamPool {
+private:
+    struct IdleConnection {
+        LocalPtr<TcpConnection> conn;
+        TimePoint since;
+    };
+
+    Reactor* reactor_;
+    std::string ip_;
+    int port_ = 0;
+    std::string unix_path_;             // 非空时经 Unix 域 socket 连接，ip_ / port_ 不使用
+    UpstreamOptions options_;
+
+    Semaphore limit_;
+    std::vector<IdleConnection> idle_;  // 栈：最近归还的在末尾，复用时取最"热"的一条
+    TimerId health_timer_ = 0;
+    bool stopped_ = false;
+    UpstreamStats stats_;
+
+    // acquire() 的 continuation 可能在池销毁之后才运行，先经由它确认池还在
+    struct Liveness : public RefCounted<Liveness> {
+        UpstreamPool* pool;
+        explicit Liveness(UpstreamPool* p) : pool(p) {}
+    };
+    LocalPtr<Liveness> alive_;
+
+public:
+    UpstreamPool(Reactor* reactor, std::string ip, int port,
+                 const UpstreamOptions& options = UpstreamOptions())
+        : reactor_(reactor), ip_(std::move(ip)), port_(port), options_(options),
+          limit_(options.max_connections), alive_(make_local<Liveness>(this)) {}
+
+    UpstreamPool(Reactor* reactor, UnixEndpoint endpoint,
+                 const UpstreamOptions& options = UpstreamOptions())
+        : reactor_(reactor), unix_path_(std::move(endpoint.path)), options_(options),
+          limit_(options.max_connections), alive_(make_local<Liveness>(this)) {}
+
+    UpstreamPool(const UpstreamPool&) = delete;
+    UpstreamPool& operator=(const UpstreamPool&) = delete;
+
+    ~UpstreamPool() {
+        stop();
+        alive_->pool = nullptr;
+    }
+
+    // 结果为空指针表示建连失败或超时（名额已经归还），或者池已经停止
+    Future<LocalPtr<TcpConnection>> acquire() {
+        using Result = Future<LocalPtr<TcpConnection>>;
+        return limit_.wait().then([this, alive = alive_](bool ok) {
+            if (!ok || !alive->pool) return Result::make_ready(LocalPtr<TcpConnection>());
+            if (stopped_) {
+                limit_.signal();
+                return Result::make_ready(LocalPtr<TcpConnection>());
+            }
+            while (!idle_.empty()) {
+                IdleConnection idle = std::move(idle_.back());
+                idle_.pop_back();
+                if (healthy(idle)) {
+                    ++stats_.reused;
+                    return Result::make_ready(std::move(idle.conn));
+                }
+                evict(idle.conn);
+            }
+
+            ++stats_.connects;
+            return connect().then([this, alive](LocalPtr<TcpConnection> conn) {
+                if (!alive->pool) {
+                    if (conn) conn->close();
+                    return LocalPtr<TcpConnection>();
+                }
+                if (!conn) {
+                    ++stats_.connect_failures;
+                    limit_.signal();
+                }
+                return conn;
+            });
+        });
+    }
+
+    // 每次成功的 acquire() 对应一次 release()；acquire() 得到空指针时名额已经归还，不需要 release
+    void release(LocalPtr<TcpConnection> conn, bool reusable = true) {
+        if (!conn) return;
+        if (reusable && !stopped_ && idle_.size() < options_.max_idle &&
+            !conn->is_closed() && conn->buffered_bytes() == 0) {
+            // 先放回空闲栈再归还名额：被唤醒的 acquire() 可以直接复用这条连接
+            idle_.push_back(IdleConnection{std::move(conn), Clock::now()});
+            schedule_health_check();
+        } else {
+            conn->close();
+        }
+        limit_.signal();
+    }
+
+    // 关闭所有空闲连接并停止健康检查；排队中的 acquire() 得到空指针，已借出的连接归还时直接关闭
+    void stop() {
+        if (stopped_) return;
+        stopped_ = true;
+        limit_.broken();
+        if (health_timer_) reactor_->cancel_timer(health_timer_);
+        health_timer_ = 0;
+        for (auto& idle : idle_) idle.conn->close();
+        idle_.clear();
+    }
+
+    size_t idle_connections() const { return idle_.size(); }
+    size_t in_use() const { return options_.max_connections - limit_.available_units(); }
+    const UpstreamStats& stats() const { return stats_; }
+
+private:
+    Future<LocalPtr<TcpConnection>> connect() {
+        if (!unix_path_.empty()) {
+            return TcpConnection::connect_unix(reactor_, unix_path_, options_.connect_timeout_ms, options_.socket);
+        }
+        return TcpConnection::connect(reactor_, ip_, port_, options_.connect_timeout_ms, options_.socket);
+    }
+
+    bool healthy(const IdleConnection& idle) const {
+        if (idle.conn->is_closed() || idle.conn->buffered_bytes() > 0) return false;
+        return Clock::now() - idle.since < std::chrono::milliseconds(options_.idle_timeout_ms);
+    }
+
+    void evict(const LocalPtr<TcpConnection>& conn) {
+        ++stats_.evicted;
+        conn->close();
+    }
+
+    // 只在有空闲连接时运行，没有空闲连接的池不产生定时器唤醒
+    void schedule_health_check() {
+        if (health_timer_ || stopped_) return;
+        health_timer_ = reactor_->run_after(options_.health_check_interval_ms, [this]() {
+            health_timer_ = 0;
+            check_idle();
+            if (!idle_.empty()) schedule_health_check();
+        });
+    }
+
+    void check_idle() {
+        std::vector<IdleConnection> kept;
+        kept.reserve(idle_.size());
+        for (auto& idle : idle_) {
+            if (healthy(idle)) {
+                kept.push_back(std::move(idle));
+            } else {
+                evict(idle.conn);
+            }
+        }
+        idle_.swap(kept);
+    }
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include "Future.h"
+#include "Poolable.h"
+
+/**
+ * 等待者节点
+ * Semaphore / ConditionVariable 的挂起者都用它表示，节点本身走 Poolable，
+ * 串成侵入式 FIFO 链表，挂起/唤醒全程不碰全局堆
+ * promise 的结果：true 表示正常唤醒（拿到信号量 / 被通知），
+ * false 表示所等待的对象已损坏或被销毁，调用方不能再访问它
+ */
+struct Waiter : public Poolable<Waiter>
+{
+    Promise<bool> promise;
+    size_t units = 0;                 // Semaphore 使用：需要的信号量数
+    std::function<bool()> pred;       // ConditionVariable 使用：唤醒前需满足的条件
+    Waiter* next = nullptr;
+};
+
+/**
+ * 侵入式 FIFO 等待队列（shard 内部使用，无锁无原子）
+ */
+class WaitQueue
+{
+    Waiter* head_ = nullptr;
+    Waiter* tail_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    WaitQueue() = default;
+
+    WaitQueue(const WaitQueue&) = delete;
+    WaitQueue& operator=(const WaitQueue&) = delete;
+
+    ~WaitQueue() { break_all(); }
+
+    // 以 false 唤醒所有挂起者：所在对象损坏或销毁时调用，避免 continuation 永远悬空，
+    // 也不会让它们误以为拿到了资源
+    void break_all() {
+        while (!empty()) {
+            Waiter* w = pop_front();
+            w->promise.set_value(false);
+            delete w;
+        }
+    }
+
+    bool empty() const { return head_ == nullptr; }
+    size_t size() const { return size_; }
+
+    Waiter* front() const { return head_; }
+
+    void push_back(Waiter* w) {
+        w->next = nullptr;
+        if (tail_) tail_->next = w;
+        else head_ = w;
+        tail_ = w;
+        ++size_;
+    }
+
+    Waiter* pop_front() {
+        Waiter* w = head_;
+        head_ = w->next;
+        if (!head_) tail_ = nullptr;
+        w->next = nullptr;
+        --size_;
+        return w;
+    }
+};
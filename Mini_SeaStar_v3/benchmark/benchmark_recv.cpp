@@ -0,0 +1,130 @@
+// 接收路径吞吐：大块上传 / 流水线小请求
+// 编译：g++ -O3 -I.. benchmark_recv.cpp ../Reactor.cpp -o benchmark_recv -lpthread
+// 运行：./benchmark_recv [上传 MB=2048] [小请求数=2000000]
+// 服务端每次 read() 拿到一个 Packet，逐分片扫描数据（上传：累加字节；流水线：数 "\r\n\r\n"），
+// 模拟协议解析对数据的一次访问；客户端在同一进程的独立线程里尽可能快地发送
+#include "../Seastar.h"
+#include "../TcpServer.h"
+#include "../TcpConnection.h"
+#include "../FutureUtil.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using namespace seastar;
+
+constexpr int kPort = 8090;
+
+struct Result {
+    size_t bytes = 0;
+    size_t requests = 0;
+    uint64_t checksum = 0;
+};
+
+// 两个阶段共享的计数，只在 shard 上修改；客户端结束后读取
+static Result g_upload, g_pipeline;
+
+void serve(LocalPtr<TcpConnection> conn) {
+    // 每个连接先收到 1 字节的模式标记：'U' 上传，'P' 流水线
+    auto mode = std::make_shared<char>(0);
+    repeat([conn, mode]() {
+        return conn->read().then([mode](Packet p) {
+            if (p.size() == 0) return StopIteration::yes;
+            size_t skip = 0;
+            if (*mode == 0) {
+                *mode = p.fragment(0).data()[0];
+                skip = 1;
+            }
+            Result& r = *mode == 'U' ? g_upload : g_pipeline;
+            r.bytes += p.size() - skip;
+            for (size_t i = 0; i < p.nr_frags(); ++i) {
+                const char* d = p.fragment(i).data();
+                size_t n = p.fragment(i).size;
+                if (*mode == 'U') {
+                    uint64_t sum = 0;
+                    for (size_t k = 0; k < n; k += 64) sum += static_cast<unsigned char>(d[k]);
+                    r.checksum += sum;
+                } else {
+                    // 请求不会跨分片切断分隔符时才计数准确；这里只用于近似统计
+                    const char* end = d + n;
+                    while ((d = static_cast<const char*>(memmem(d, end - d, "\r\n\r\n", 4)))) {
+                        ++r.requests;
+                        d += 4;
+                    }
+                }
+            }
+            return StopIteration::no;
+        });
+    });
+}
+
+int connect_local() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::usleep(10000);
+    }
+    return fd;
+}
+
+double send_all(char mode, const std::string& chunk, size_t rounds) {
+    int fd = connect_local();
+    ::write(fd, &mode, 1);
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        size_t off = 0;
+        while (off < chunk.size()) {
+            ssize_t n = ::write(fd, chunk.data() + off, chunk.size() - off);
+            if (n <= 0) break;
+            off += n;
+        }
+    }
+    ::shutdown(fd, SHUT_WR);
+    char c;
+    ::read(fd, &c, 1); // 等服务端读完并关闭
+    auto end = std::chrono::steady_clock::now();
+    ::close(fd);
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char** argv) {
+    size_t upload_mb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2048;
+    size_t small_reqs = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+
+    Engine engine;
+    std::thread client([&]() {
+        std::string block(1 << 20, 'x');
+        double up = send_all('U', block, upload_mb);
+
+        std::string req = "GET /index.html HTTP/1.1\r\nHost: bench\r\nUser-Agent: benchmark_recv\r\n\r\n";
+        std::string batch;
+        for (int i = 0; i < 512; ++i) batch += req;
+        double pipe = send_all('P', batch, small_reqs / 512);
+
+        std::printf("upload:    %8.1f MB/s  (%zu MB)\n", g_upload.bytes / up / 1e6, g_upload.bytes >> 20);
+        std::printf("pipelined: %8.2f Mreq/s (%zu requests, %.1f MB/s)\n",
+                    g_pipeline.requests / pipe / 1e6, g_pipeline.requests, g_pipeline.bytes / pipe / 1e6);
+        engine.stop();
+    });
+
+    engine.run([] {
+        static thread_local std::unique_ptr<TcpServer> server;
+        Reactor* r = Reactor::instance();
+        server = std::make_unique<TcpServer>(r);
+        server->set_connection_handler([r](Socket sock) {
+            auto conn = TcpConnection::create(std::move(sock), r);
+            serve(conn);
+        });
+        server->listen(kPort);
+    });
+    client.join();
+    return 0;
+}
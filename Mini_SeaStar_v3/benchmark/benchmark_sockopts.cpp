@@ -0,0 +1,199 @@
+// socket 选项配置对短连接建连速率与请求延迟的影响
+// 编译：g++ -O3 -I.. benchmark_sockopts.cpp ../Reactor.cpp -o benchmark_sockopts -lpthread
+// 运行：./benchmark_sockopts [短连接次数=5000] [往返次数=20000]
+// 每种 SocketOptions 配置在各自的端口上起一个 TcpServer，客户端线程用同一配置（apply_client）做两组测试：
+//   churn    每次新建连接 -> 发请求 -> 服务端回完响应后主动关闭，报告每秒完成的连接数
+//   latency  一条长连接一问一答，报告 p50 / p99
+// 响应分两次 write（响应头、响应体），不关 Nagle 时第二段要等对端的延迟 ACK
+// TCP_FASTOPEN 需要 net.ipv4.tcp_fastopen 含服务端位（echo 3 > /proc/sys/net/ipv4/tcp_fastopen），
+// 否则那一行等同于只开 no_delay；SO_BUSY_POLL 在回环上没有网卡队列可轮询，需要在真实网卡上对比
+#include "../Seastar.h"
+#include "../TcpServer.h"
+#include "../TcpConnection.h"
+#include "../SocketOptions.h"
+#include "../FutureUtil.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace seastar;
+
+constexpr int kBasePort = 8093;
+
+const std::string kHeader =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Length: 12\r\n"
+    "\r\n";
+const std::string kBody = "Hello World!";
+
+// 请求的第一个字节：'C' 表示回完响应后关闭连接，'K' 表示保持连接
+const std::string kCloseRequest = "C / HTTP/1.1\r\n\r\n";
+const std::string kKeepRequest = "K / HTTP/1.1\r\n\r\n";
+
+struct Profile {
+    const char* name;
+    SocketOptions options;
+};
+
+std::vector<Profile> make_profiles() {
+    std::vector<Profile> profiles;
+    profiles.push_back({"default", SocketOptions{}});
+
+    SocketOptions nodelay;
+    nodelay.no_delay = true;
+    profiles.push_back({"no_delay", nodelay});
+
+    SocketOptions defer = nodelay;
+    defer.defer_accept = 1;
+    profiles.push_back({"defer_accept", defer});
+
+    SocketOptions tfo = nodelay;
+    tfo.fast_open = 256;
+    tfo.fast_open_connect = true;
+    profiles.push_back({"fast_open", tfo});
+
+    SocketOptions buffers = nodelay;
+    buffers.recv_buffer = 16 * 1024;
+    buffers.send_buffer = 16 * 1024;
+    profiles.push_back({"buffers_16k", buffers});
+
+    SocketOptions lowat = nodelay;
+    lowat.notsent_lowat = 16 * 1024;
+    profiles.push_back({"notsent_lowat", lowat});
+
+    SocketOptions busy = nodelay;
+    busy.busy_poll = 50;
+    profiles.push_back({"busy_poll", busy});
+    return profiles;
+}
+
+void serve(LocalPtr<TcpConnection> conn) {
+    repeat([conn]() {
+        return conn->read().then([conn](Packet p) {
+            if (p.size() == 0) return Future<StopIteration>::make_ready(StopIteration::yes);
+            bool close = p.data()[0] == 'C';
+
+            static thread_local Packet header = Packet::from_string(kHeader);
+            static thread_local Packet body = Packet::from_string(kBody);
+            conn->write(header.share());
+            return conn->write(body.share()).then([conn, close](ssize_t n) {
+                if (n < 0) return StopIteration::yes;
+                if (close) {
+                    conn->close();
+                    return StopIteration::yes;
+                }
+                return StopIteration::no;
+            });
+        });
+    });
+}
+
+sockaddr_in server_addr(int port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    return addr;
+}
+
+// 阻塞客户端 socket，选项与服务端同一份配置
+Socket connect_with(const SocketOptions& options, int port) {
+    Socket sock(::socket(AF_INET, SOCK_STREAM, 0));
+    options.apply_client(sock);
+    sockaddr_in addr = server_addr(port);
+    while (::connect(sock.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::usleep(10000);
+    }
+    return sock;
+}
+
+bool read_response(int fd) {
+    static char buf[256];
+    size_t want = kHeader.size() + kBody.size();
+    size_t got = 0;
+    while (got < want) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) return false;
+        got += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+double churn(const SocketOptions& options, int port, size_t conns) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < conns; ++i) {
+        Socket sock = connect_with(options, port);
+        // 开启 TCP_FASTOPEN_CONNECT 时，这次 write 的数据随 SYN 一起发出
+        ::write(sock.fd(), kCloseRequest.data(), kCloseRequest.size());
+        read_response(sock.fd());
+        char c;
+        while (::read(sock.fd(), &c, 1) > 0) {}  // 等服务端关闭，TIME_WAIT 留在服务端
+    }
+    auto end = std::chrono::steady_clock::now();
+    return conns / std::chrono::duration<double>(end - begin).count();
+}
+
+void latency(const SocketOptions& options, int port, size_t rounds, double& p50, double& p99) {
+    Socket sock = connect_with(options, port);
+    std::vector<double> rtt;
+    rtt.reserve(rounds);
+    // 不关 Nagle 时每次往返要等一个延迟 ACK（几十毫秒），最多测 5 秒
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    for (size_t i = 0; i < rounds; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        if (begin > deadline) break;
+        ::write(sock.fd(), kKeepRequest.data(), kKeepRequest.size());
+        if (!read_response(sock.fd())) break;
+        auto end = std::chrono::steady_clock::now();
+        rtt.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+    }
+    std::sort(rtt.begin(), rtt.end());
+    p50 = rtt.empty() ? 0 : rtt[rtt.size() / 2];
+    p99 = rtt.empty() ? 0 : rtt[rtt.size() * 99 / 100];
+}
+
+int main(int argc, char** argv) {
+    size_t conns = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+    size_t rounds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+    static const std::vector<Profile> profiles = make_profiles();
+
+    int tfo = 0;
+    std::ifstream("/proc/sys/net/ipv4/tcp_fastopen") >> tfo;
+
+    Engine engine;
+    std::thread client([&]() {
+        if (!(tfo & 2)) std::printf("net.ipv4.tcp_fastopen=%d: server side TFO is disabled\n", tfo);
+        std::printf("%-14s %12s %12s %12s\n", "profile", "churn conn/s", "p50 us", "p99 us");
+        for (size_t i = 0; i < profiles.size(); ++i) {
+            int port = kBasePort + static_cast<int>(i);
+            double rate = churn(profiles[i].options, port, conns);
+            double p50 = 0, p99 = 0;
+            latency(profiles[i].options, port, rounds, p50, p99);
+            std::printf("%-14s %12.0f %12.2f %12.2f\n", profiles[i].name, rate, p50, p99);
+        }
+        engine.stop();
+    });
+
+    engine.run([] {
+        static thread_local std::vector<std::unique_ptr<TcpServer>> servers;
+        Reactor* r = Reactor::instance();
+        for (size_t i = 0; i < profiles.size(); ++i) {
+            auto server = std::make_unique<TcpServer>(r);
+            server->set_options(profiles[i].options);
+            server->set_connection_handler([r](Socket sock) {
+                serve(TcpConnection::create(std::move(sock), r));
+            });
+            server->listen(kBasePort + static_cast<int>(i));
+            servers.push_back(std::move(server));
+        }
+    });
+    client.join();
+    return 0;
+}
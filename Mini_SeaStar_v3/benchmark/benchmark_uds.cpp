@@ -0,0 +1,129 @@
+// 本机通信延迟：回环 TCP vs Unix 域 socket（文件系统路径 / 抽象命名空间）
+// 编译：g++ -O3 -I.. benchmark_uds.cpp ../Reactor.cpp -o benchmark_uds -lpthread
+// 运行：./benchmark_uds [往返次数=200000] [消息字节=64]
+// 三种监听用同一段 TcpConnection 回显代码；客户端在独立线程的 Reactor 上用 TcpConnection::connect /
+// connect_unix 建连并一问一答，报告每次往返的 p50 / p99 / 平均延迟
+#include "../Seastar.h"
+#include "../TcpServer.h"
+#include "../TcpConnection.h"
+#include "../InputStream.h"
+#include "../FutureUtil.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace seastar;
+
+constexpr int kPort = 8092;
+const std::string kUnixBase = "/tmp/benchmark_uds.sock";
+const std::string kAbstractBase = "@benchmark_uds";
+
+void echo(LocalPtr<TcpConnection> conn) {
+    repeat([conn]() {
+        return conn->read().then([conn](Packet p) {
+            if (p.size() == 0) return Future<StopIteration>::make_ready(StopIteration::yes);
+            return conn->write(std::move(p)).then([](ssize_t n) {
+                return n < 0 ? StopIteration::yes : StopIteration::no;
+            });
+        });
+    });
+}
+
+struct PingPong {
+    LocalPtr<TcpConnection> conn;
+    LocalPtr<InputStream> in;
+    Packet msg;
+    size_t remaining;
+    TimePoint begin;
+    std::vector<double> rtt;
+};
+
+// 一问一答：写出一条消息，读满同样长度的回显后再发下一条
+Future<void> ping_pong(const char* name, LocalPtr<TcpConnection> conn, size_t rounds, size_t msg_size) {
+    if (!conn) {
+        std::printf("%-10s connect failed\n", name);
+        return Future<void>::make_ready();
+    }
+    auto pp = std::make_shared<PingPong>();
+    pp->conn = conn;
+    pp->in = make_local<InputStream>(conn);
+    pp->msg = Packet::from_string(std::string(msg_size, 'p'));
+    pp->remaining = rounds;
+    pp->rtt.reserve(rounds);
+
+    return repeat([pp, msg_size]() {
+        pp->begin = Clock::now();
+        pp->conn->write(pp->msg.share());
+        return pp->in->read_exactly(msg_size).then([pp, msg_size](Packet p) {
+            if (p.size() < msg_size) return StopIteration::yes;
+            pp->rtt.push_back(std::chrono::duration<double, std::micro>(Clock::now() - pp->begin).count());
+            return --pp->remaining == 0 ? StopIteration::yes : StopIteration::no;
+        });
+    }).then([name, pp]() {
+        pp->conn->close();
+        auto& rtt = pp->rtt;
+        if (rtt.empty()) return;
+        double sum = 0;
+        for (double v : rtt) sum += v;
+        std::sort(rtt.begin(), rtt.end());
+        std::printf("%-10s p50 %7.2f us   p99 %7.2f us   avg %7.2f us\n",
+                    name, rtt[rtt.size() / 2], rtt[rtt.size() * 99 / 100], sum / rtt.size());
+    });
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    size_t msg_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+
+    Engine engine;
+    std::thread client;
+    engine.run([&] {
+        static thread_local std::unique_ptr<TcpServer> tcp, uds, abstract;
+        Reactor* r = Reactor::instance();
+        auto handler = [r](Socket sock) {
+            echo(TcpConnection::create(std::move(sock), r));
+        };
+        tcp = std::make_unique<TcpServer>(r);
+        tcp->set_connection_handler(handler);
+        tcp->listen(kPort);
+
+        uds = std::make_unique<TcpServer>(r);
+        uds->set_connection_handler(handler);
+        uds->listen_unix(TcpServer::shard_path(kUnixBase, cpu_id()));
+
+        abstract = std::make_unique<TcpServer>(r);
+        abstract->set_connection_handler(handler);
+        abstract->listen_unix(TcpServer::shard_path(kAbstractBase, cpu_id()));
+
+        // shard 0 的三个监听就绪后再启动客户端
+        if (cpu_id() != 0) return;
+        client = std::thread([&engine, rounds, msg_size]() {
+            Reactor reactor;
+            Reactor* cr = &reactor;
+            SocketOptions options;
+            options.no_delay = true;
+            // Unix 域 socket 没有 SO_REUSEPORT 分流，客户端直接连 shard 0 的路径
+            TcpConnection::connect(cr, "127.0.0.1", kPort, 3000, options).then([=](LocalPtr<TcpConnection> conn) {
+                return ping_pong("tcp", conn, rounds, msg_size);
+            }).then([cr]() {
+                return TcpConnection::connect_unix(cr, TcpServer::shard_path(kUnixBase, 0));
+            }).then([=](LocalPtr<TcpConnection> conn) {
+                return ping_pong("unix", conn, rounds, msg_size);
+            }).then([cr]() {
+                return TcpConnection::connect_unix(cr, TcpServer::shard_path(kAbstractBase, 0));
+            }).then([=](LocalPtr<TcpConnection> conn) {
+                return ping_pong("abstract", conn, rounds, msg_size);
+            }).then([cr]() {
+                cr->stop();
+            });
+            reactor.run();
+            engine.stop();
+        });
+    });
+    client.join();
+    return 0;
+}
@@ -0,0 +1,115 @@
+// 网关访问上游：每个请求新建连接 vs UpstreamPool 复用 keep-alive 连接
+// 编译：g++ -O3 -I.. benchmark_upstream.cpp ../Reactor.cpp -o benchmark_upstream -lpthread
+// 运行：./benchmark_upstream [请求数=20000] [并发=16]
+// 上游是同一进程里的回显 TcpServer；shard 0 以固定并发发请求，每个请求 acquire -> 写 -> 读 -> release，
+// 报告吞吐与每个请求（含建连）的 p50 / p99，以及池的建连 / 复用次数
+#include "../Seastar.h"
+#include "../TcpServer.h"
+#include "../TcpConnection.h"
+#include "../UpstreamPool.h"
+#include "../FutureUtil.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace seastar;
+
+constexpr int kPort = 8100;
+
+void echo(LocalPtr<TcpConnection> conn) {
+    repeat([conn]() {
+        return conn->read().then([conn](Packet p) {
+            if (p.size() == 0) return Future<StopIteration>::make_ready(StopIteration::yes);
+            return conn->write(std::move(p)).then([](ssize_t n) {
+                return n < 0 ? StopIteration::yes : StopIteration::no;
+            });
+        });
+    });
+}
+
+struct Run {
+    UpstreamPool* pool;
+    bool reuse;                 // false：每个请求用完就关闭，下一次重新建连
+    size_t remaining;
+    size_t inflight = 0;
+    std::vector<double> latency;
+    Promise<void> done;
+};
+
+void issue(std::shared_ptr<Run> run) {
+    if (run->remaining == 0) {
+        if (run->inflight == 0) run->done.set_value();
+        return;
+    }
+    --run->remaining;
+    ++run->inflight;
+    auto begin = Clock::now();
+    static thread_local Packet request = Packet::from_string("GET /upstream\r\n");
+    run->pool->acquire().then([run](LocalPtr<TcpConnection> conn) {
+        if (!conn) return Future<bool>::make_ready(false);
+        return conn->write(request.share()).then([conn](ssize_t) {
+            return conn->read();
+        }).then([run, conn](Packet p) {
+            bool ok = p.size() == request.size();
+            run->pool->release(conn, ok && run->reuse);
+            return ok;
+        });
+    }).then([run, begin](bool ok) {
+        if (!ok) std::printf("request failed\n");
+        run->latency.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+        --run->inflight;
+        issue(run);
+    });
+}
+
+Future<void> measure(const char* name, bool reuse, size_t requests, size_t concurrency) {
+    UpstreamOptions options;
+    options.max_connections = concurrency;
+    options.max_idle = concurrency;
+    auto pool = std::make_shared<UpstreamPool>(Reactor::instance(), "127.0.0.1", kPort, options);
+    auto run = std::make_shared<Run>();
+    run->pool = pool.get();
+    run->reuse = reuse;
+    run->remaining = requests;
+    run->latency.reserve(requests);
+
+    auto begin = Clock::now();
+    auto fut = run->done.get_future();
+    for (size_t i = 0; i < concurrency; ++i) issue(run);
+    return fut.then([name, pool, run, begin]() {
+        double secs = std::chrono::duration<double>(Clock::now() - begin).count();
+        auto& v = run->latency;
+        std::sort(v.begin(), v.end());
+        const UpstreamStats& st = pool->stats();
+        std::printf("%-10s %10.0f req/s   p50 %8.2f us   p99 %8.2f us   connects %lu reused %lu\n",
+                    name, v.size() / secs, v[v.size() / 2], v[v.size() * 99 / 100],
+                    static_cast<unsigned long>(st.connects), static_cast<unsigned long>(st.reused));
+        pool->stop();
+    });
+}
+
+int main(int argc, char** argv) {
+    static size_t requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    static size_t concurrency = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+
+    Engine engine;
+    engine.run([&engine] {
+        static thread_local std::unique_ptr<TcpServer> server;
+        Reactor* r = Reactor::instance();
+        server = std::make_unique<TcpServer>(r);
+        server->set_connection_handler([r](Socket sock) {
+            echo(TcpConnection::create(std::move(sock), r));
+        });
+        server->listen(kPort);
+
+        if (cpu_id() != 0) return;
+        measure("connect", false, requests, concurrency).then([] {
+            return measure("pooled", true, requests, concurrency);
+        }).then([&engine] {
+            engine.stop();
+        });
+    });
+    return 0;
+}
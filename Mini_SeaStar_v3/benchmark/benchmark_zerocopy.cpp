@@ -0,0 +1,136 @@
+// 发送路径：普通拷贝 vs MSG_ZEROCOPY，按单次写入大小找交叉点
+// 编译：g++ -O3 -I.. benchmark_zerocopy.cpp ../Reactor.cpp -o benchmark_zerocopy -lpthread
+// 运行：./benchmark_zerocopy [每组发送 MB=1024]
+// 服务端反复 write() 同一个共享 Packet，客户端线程读到 EOF；每组报告吞吐、整个进程每 GB 消耗的
+// CPU 时间，以及内核报告"退回拷贝"的比例
+// 注意回环上内核总会在接收端把零拷贝的页再拷贝一次（copied 接近 100%），这里测到的是
+// 钉页 + 完成通知的额外开销；真实网卡上的收益需要在两台机器之间测
+#include "../Seastar.h"
+#include "../TcpServer.h"
+#include "../TcpConnection.h"
+#include "../InputStream.h"
+#include "../FutureUtil.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using namespace seastar;
+
+constexpr int kPort = 8091;
+
+// 客户端发来的请求头：模式 + 单次写入大小 + 总字节数
+struct Request {
+    char zero_copy;
+    uint32_t write_size;
+    uint64_t total;
+} __attribute__((packed));
+
+// 零拷贝那一组的完成统计：只在 shard 上写，客户端在收到 EOF 后读取
+static ZeroCopyStats g_zc_stats;
+
+void serve(LocalPtr<TcpConnection> conn) {
+    auto in = make_local<InputStream>(conn);
+    in->read_exactly(sizeof(Request)).then([conn, in](Packet p) {
+        if (p.size() != sizeof(Request)) {
+            conn->close();
+            return;
+        }
+        Request req;
+        std::memcpy(&req, p.data(), sizeof(req));
+        // 阈值设为 0：这一组里每次发送都走零拷贝，交叉点由写入大小决定
+        if (req.zero_copy) conn->set_zero_copy(true, 0);
+
+        auto payload = std::make_shared<Packet>(Packet(std::string(req.write_size, 'z').data(), req.write_size));
+        auto sent = std::make_shared<uint64_t>(0);
+        repeat([conn, payload, sent, total = req.total]() {
+            if (*sent >= total) return Future<StopIteration>::make_ready(StopIteration::yes);
+            return conn->write(payload->share()).then([sent](ssize_t n) {
+                if (n < 0) return StopIteration::yes;
+                *sent += static_cast<uint64_t>(n);
+                return StopIteration::no;
+            });
+        }).then([conn]() {
+            g_zc_stats = conn->zero_copy_stats();
+            conn->close();
+        });
+    });
+}
+
+int connect_local() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::usleep(10000);
+    }
+    return fd;
+}
+
+double cpu_seconds() {
+    rusage ru{};
+    ::getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+struct Sample {
+    double mb_per_s;
+    double cpu_per_gb;
+};
+
+Sample run_once(bool zero_copy, uint32_t write_size, uint64_t total) {
+    int fd = connect_local();
+    Request req{zero_copy ? char(1) : char(0), write_size, total};
+    ::write(fd, &req, sizeof(req));
+
+    static char sink[1 << 20];
+    uint64_t got = 0;
+    double cpu_begin = cpu_seconds();
+    auto begin = std::chrono::steady_clock::now();
+    ssize_t n;
+    while ((n = ::read(fd, sink, sizeof(sink))) > 0) got += static_cast<uint64_t>(n);
+    auto end = std::chrono::steady_clock::now();
+    double cpu = cpu_seconds() - cpu_begin;
+    ::close(fd);
+
+    double secs = std::chrono::duration<double>(end - begin).count();
+    return Sample{got / secs / 1e6, cpu / (got / 1e9)};
+}
+
+int main(int argc, char** argv) {
+    uint64_t total = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024) << 20;
+
+    Engine engine;
+    std::thread client([&]() {
+        std::printf("%10s %12s %12s %14s %14s %8s\n",
+                    "write", "copy MB/s", "zc MB/s", "copy cpu s/GB", "zc cpu s/GB", "copied");
+        for (uint32_t size = 4096; size <= (4u << 20); size *= 4) {
+            Sample copy = run_once(false, size, total);
+            Sample zc = run_once(true, size, total);
+            const ZeroCopyStats& st = g_zc_stats;
+            double copied = st.completed ? 100.0 * st.copied / st.completed : 0.0;
+            std::printf("%9uK %12.1f %12.1f %14.3f %14.3f %7.1f%%\n",
+                        size >> 10, copy.mb_per_s, zc.mb_per_s, copy.cpu_per_gb, zc.cpu_per_gb, copied);
+        }
+        engine.stop();
+    });
+
+    engine.run([] {
+        static thread_local std::unique_ptr<TcpServer> server;
+        Reactor* r = Reactor::instance();
+        server = std::make_unique<TcpServer>(r);
+        server->set_connection_handler([r](Socket sock) {
+            serve(TcpConnection::create(std::move(sock), r));
+        });
+        server->listen(kPort);
+    });
+    client.join();
+    return 0;
+}
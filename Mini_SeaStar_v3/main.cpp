@@ -3,9 +3,11 @@
 #include <string>
 #include "Seastar.h"
 #include "TcpServer.h"
+#include "SocketOptions.h"
 #include "TcpConnection.h"
 #include "Packet.h"
 #include "IntrusivePtr.h"
+#include "FutureUtil.h"
 
 using namespace seastar;
 
@@ -17,16 +19,20 @@ const std::string HTTP_RESPONSE_STR =
     "\r\n"
     "Hello World!";
 
-// main.cpp 修正版
-void start_http_bench(LocalPtr<TcpConnection> conn) { // 👈 修改这里
-    conn->read().then([conn](Packet p) {
-        if (p.size() == 0) return;
-        
-        static thread_local Packet response_packet = Packet::from_string(HTTP_RESPONSE_STR);
+// 用 repeat 驱动 keep-alive 循环：整个连接只有一个循环状态对象，
+// 数据已缓冲（流水线请求）时直接在内联循环里处理，不再每轮递归重建调用链
+void start_http_bench(LocalPtr<TcpConnection> conn) {
+    repeat([conn]() {
+        return conn->read().then([conn](Packet p) {
+            if (p.size() == 0) {
+                return Future<StopIteration>::make_ready(StopIteration::yes);
+            }
 
-        conn->write(response_packet.share()).then([conn](ssize_t n) {
-            if (n < 0) return;
-            start_http_bench(conn); // 这里的递归调用现在也是 LocalPtr 了
+            static thread_local Packet response_packet = Packet::from_string(HTTP_RESPONSE_STR);
+
+            return conn->write(response_packet.share()).then([](ssize_t n) {
+                return n < 0 ? StopIteration::yes : StopIteration::no;
+            });
         });
     });
 }
@@ -40,11 +46,13 @@ int main() {
         Reactor* r = Reactor::instance();
         server = std::make_unique<TcpServer>(r);
 
-        server->set_connection_handler([r](Socket sock) {
-            // ★ 新增：关闭 Nagle 算法，小包立即发送
-            // 对 ~100 字节的 HTTP 响应至关重要
-            sock.set_tcp_no_delay(true);
+        // 关闭 Nagle 算法，小包立即发送，对 ~100 字节的 HTTP 响应至关重要
+        // 设置在监听 socket 上由新连接继承，accept 之后不再需要额外的 setsockopt
+        SocketOptions options;
+        options.no_delay = true;
+        server->set_options(options);
 
+        server->set_connection_handler([r](Socket sock) {
             auto conn = TcpConnection::create(std::move(sock), r);
             start_http_bench(conn);
         });
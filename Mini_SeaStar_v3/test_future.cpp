@@ -0,0 +1,276 @@
+// Future 就绪路径 / repeat / do_until / keep_doing / SharedFuture / SingleFlight / 对象池 chunk 大小测试
+// 编译：g++ -std=c++17 -O2 test_future.cpp Reactor.cpp -o test_future -lpthread
+#include "Seastar.h"
+#include "FutureUtil.h"
+#include "SharedFuture.h"
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace seastar;
+
+// 统计本线程经 operator new 的堆分配次数（std::function 装不下的捕获等）
+// noinline：内联后编译器会把 operator new 和 free 配对检查，误报 mismatched-new-delete
+static thread_local size_t g_heap_allocs = 0;
+
+__attribute__((noinline)) void* operator new(size_t n) {
+    ++g_heap_allocs;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// 本线程所有对象池里存活的对象数（Promise / State / 循环状态都池化）
+size_t pool_live() {
+    size_t n = 0;
+    for (const PoolStats& s : PoolRegistry::local().stats()) n += s.live;
+    return n;
+}
+
+Future<void> sleep_ms(int ms) {
+    auto p = make_local<Promise<void>>();
+    auto fut = p->get_future();
+    Reactor::instance()->run_after(ms, [p]() { p->set_value(); });
+    return fut;
+}
+
+// 下一轮调度时才完成的 Future，模拟挂起一次的 I/O
+Future<int> next_tick(int v) {
+    auto p = make_local<Promise<int>>();
+    auto fut = p->get_future();
+    schedule_task([p, v]() { p->set_value(v); });
+    return fut;
+}
+
+// 1. 就绪的 Future 上 then()：内联执行，值留在 Future 里，不分配 Promise/State，也不分配堆
+Future<void> test_ready_then() {
+    std::cout << "--- Test 1: Ready then() ---" << std::endl;
+    constexpr int kCount = 1000;
+    std::vector<Future<int>> kept;
+    kept.reserve(kCount);
+    std::vector<Future<void>> kept_void;
+    kept_void.reserve(kCount);
+
+    size_t live = pool_live();
+    size_t heap = g_heap_allocs;
+    int sum = 0;
+    for (int i = 0; i < kCount; ++i) {
+        kept.push_back(Future<int>::make_ready(i).then([](int v) {
+            return Future<int>::make_ready(v + 1);   // 返回 Future 的 continuation 直接展开
+        }).then([](int v) {
+            return v * 2;
+        }));
+        kept_void.push_back(Future<void>::make_ready().then([&sum, i]() { sum += i; }));
+    }
+    assert(g_heap_allocs == heap);
+    assert(pool_live() == live);
+    assert(sum == kCount * (kCount - 1) / 2);
+
+    for (int i = 0; i < kCount; ++i) {
+        assert(kept[i].available() && kept[i].get() == (i + 1) * 2);
+        assert(kept_void[i].available());
+    }
+
+    // 挂起的 Future 上 then() 仍然在完成后才执行
+    auto ran = std::make_shared<bool>(false);
+    auto fut = next_tick(7).then([ran](int v) {
+        *ran = true;
+        return v + 1;
+    });
+    assert(!*ran && !fut.available());
+    return fut.then([ran](int v) {
+        assert(*ran && v == 8);
+    });
+}
+
+// 2. repeat：一路就绪的迭代不分配、连续 kMaxInlineIterations 轮后让出一次；挂起后从原处继续
+Future<void> test_repeat() {
+    std::cout << "--- Test 2: repeat ---" << std::endl;
+    constexpr int kReady = 1000;
+    auto count = std::make_shared<int>(0);
+    auto yielded_at = std::make_shared<int>(-1);
+    schedule_task([count, yielded_at]() { *yielded_at = *count; });
+
+    // 从第一轮开始计：循环状态所在对象池第一次使用时的登记不算在迭代里
+    auto heap_at = std::make_shared<std::vector<size_t>>();
+    heap_at->reserve(2);
+    auto fut = repeat([count, heap_at]() {
+        ++*count;
+        if (*count == 1 || *count == static_cast<int>(kMaxInlineIterations)) heap_at->push_back(g_heap_allocs);
+        return Future<int>::make_ready(*count).then([](int n) {
+            return n == kReady ? StopIteration::yes : StopIteration::no;
+        });
+    });
+    // 第一次让出之前的 kMaxInlineIterations 轮全部内联，期间没有任何堆分配
+    assert(*count == static_cast<int>(kMaxInlineIterations));
+    assert(heap_at->size() == 2 && (*heap_at)[0] == (*heap_at)[1]);
+    assert(!fut.available());
+
+    return fut.then([count, yielded_at]() {
+        assert(*count == kReady);
+        // 先排队的任务在第一次让出时得到执行
+        assert(*yielded_at == static_cast<int>(kMaxInlineIterations));
+
+        auto suspended = std::make_shared<int>(0);
+        return repeat([suspended]() {
+            // 奇数轮挂起、偶数轮就绪
+            int n = ++*suspended;
+            Future<int> f = n % 2 ? next_tick(n) : Future<int>::make_ready(n);
+            return f.then([](int v) {
+                return v == 10 ? StopIteration::yes : StopIteration::no;
+            });
+        }).then([suspended]() {
+            assert(*suspended == 10);
+        });
+    });
+}
+
+// 3. do_until：每轮先检查条件，条件一开始就成立时 action 一次也不执行
+Future<void> test_do_until() {
+    std::cout << "--- Test 3: do_until ---" << std::endl;
+    auto calls = std::make_shared<int>(0);
+
+    auto none = do_until([]() { return true; }, [calls]() {
+        ++*calls;
+        return Future<void>::make_ready();
+    });
+    assert(none.available() && *calls == 0);
+
+    return do_until([calls]() { return *calls == 6; }, [calls]() {
+        // 每三轮挂起一次
+        if (++*calls % 3 == 0) return sleep_ms(1);
+        return Future<void>::make_ready();
+    }).then([calls]() {
+        assert(*calls == 6);
+    });
+}
+
+// 4. keep_doing：一直执行到 action 挂起不再完成为止，返回的 Future 不会完成
+Future<void> test_keep_doing() {
+    std::cout << "--- Test 4: keep_doing ---" << std::endl;
+    auto calls = std::make_shared<int>(0);
+    auto never = std::make_shared<Promise<void>>();
+    auto never_fut = std::make_shared<Future<void>>(never->get_future());
+
+    auto fut = std::make_shared<Future<void>>(keep_doing([calls, never_fut]() {
+        if (++*calls < 500) return Future<void>::make_ready();
+        return std::move(*never_fut);
+    }));
+    return sleep_ms(1).then([calls, fut, never]() {
+        assert(*calls == 500 && !fut->available());
+    });
+}
+
+// 5. SharedFuture：结果到达后、扇出任务执行前挂上的等待者排在已有等待者后面，仍按挂接顺序执行
+Future<void> test_shared_future_order() {
+    std::cout << "--- Test 5: SharedFuture FIFO ---" << std::endl;
+    auto order = std::make_shared<std::vector<int>>();
+    auto p = make_local<Promise<int>>();
+    SharedFuture<int> sf(p->get_future());
+
+    sf.then([order, sf](const int& v) mutable {
+        order->push_back(1);
+        // 扇出过程中新挂上的等待者排在队尾，不会抢在 2、3 前面
+        sf.then([order](const int&) { order->push_back(4); });
+    });
+    sf.then([order](const int&) { order->push_back(2); });
+    p->set_value(42);
+    // 排在 resolve 之后、扇出任务之前执行：结果已就绪，但 1、2 还没有运行
+    schedule_task([order, sf]() mutable {
+        assert(sf.available() && sf.get() == 42 && order->empty());
+        sf.then([order](const int&) { order->push_back(3); });
+        assert(order->empty());
+    });
+
+    return sleep_ms(1).then([order, sf]() mutable {
+        assert(*order == std::vector<int>({1, 2, 3, 4}));
+        // 扇出结束后，就绪的 SharedFuture 上 then() 立即执行
+        sf.then([order](const int&) { order->push_back(5); });
+        assert(order->back() == 5);
+    });
+}
+
+// 6. SingleFlight：在途请求合并，结果到达后 key 移出表，下次重新加载；就绪的结果不进表
+Future<void> test_single_flight() {
+    std::cout << "--- Test 6: SingleFlight ---" << std::endl;
+    auto sf = std::make_shared<SingleFlight<std::string, int>>();
+    auto loads = std::make_shared<int>(0);
+    auto p = make_local<Promise<int>>();
+    auto results = std::make_shared<std::vector<int>>();
+
+    for (int i = 0; i < 3; ++i) {
+        sf->get("k", [loads, p]() {
+            ++*loads;
+            return p->get_future();
+        }).then([results, sf](const int& v) {
+            // 表项先于任何等待者移除：这里再 get 会重新加载
+            assert(sf->in_flight() == 0);
+            results->push_back(v);
+        });
+    }
+    assert(*loads == 1 && sf->in_flight() == 1 && sf->coalesced() == 2);
+
+    auto ready = sf->get("r", []() { return Future<int>::make_ready(9); });
+    assert(ready.available() && ready.get() == 9 && sf->in_flight() == 1);
+
+    p->set_value(7);
+    return sleep_ms(1).then([sf, loads, results]() {
+        assert(*results == std::vector<int>({7, 7, 7}));
+        assert(sf->in_flight() == 0);
+        auto p2 = make_local<Promise<int>>();
+        sf->get("k", [loads, p2]() {
+            ++*loads;
+            return p2->get_future();
+        });
+        assert(*loads == 2 && sf->in_flight() == 1);
+        p2->set_value(8);
+        return sleep_ms(1);
+    }).then([sf]() {
+        assert(sf->in_flight() == 0);
+    });
+}
+
+// 7. 不开大页时各池的 chunk 按类型自身的大小取，不会每个类型都占 2MB
+Future<void> test_pool_chunk_size() {
+    std::cout << "--- Test 7: Pool Chunk Size ---" << std::endl;
+    assert(PoolConfig::huge_pages == HugePageMode::kOff);
+    size_t pools = 0;
+    for (const PoolStats& s : PoolRegistry::local().stats()) {
+        if (s.chunks == 0) continue;
+        ++pools;
+        assert(s.chunk_bytes < kHugePageSize);
+        assert(s.chunk_bytes >= s.object_size * 16);
+    }
+    assert(pools > 0);
+    return Future<void>::make_ready();
+}
+
+int main() {
+    Engine engine;
+    engine.run([&engine] {
+        if (cpu_id() != 0) return;
+
+        test_ready_then().then([]() {
+            return test_repeat();
+        }).then([]() {
+            return test_do_until();
+        }).then([]() {
+            return test_keep_doing();
+        }).then([]() {
+            return test_shared_future_order();
+        }).then([]() {
+            return test_single_flight();
+        }).then([]() {
+            return test_pool_chunk_size();
+        }).then([&engine]() {
+            std::cout << "All future tests passed" << std::endl;
+            engine.stop();
+        });
+    });
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Memory.cpp 分配器测试
+// 编译：g++ -std=c++17 -O2 test_memory.cpp Memory.cpp -o test_memory -lpthread
+#include "Memory.h"
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <malloc.h>
+#include <thread>
+
+constexpr size_t kSpan = 64 * 1024;
+
+inline uintptr_t addr(void* p) { return reinterpret_cast<uintptr_t>(p); }
+inline uintptr_t span_of(void* p) { return addr(p) / kSpan; }
+
+// 1. 相邻的空闲段合并，best-fit 从更长的段中切分
+//    在第一个新线程里做：它拿到一个全新的 shard，span 从头顺序切出
+void test_coalesce() {
+    std::cout << "--- Test 1: Span Coalescing ---" << std::endl;
+    std::thread([] {
+        void* a = malloc(100000);                        // 每个 2 个 span
+        void* b = malloc(100000);
+        void* c = malloc(100000);
+        void* guard = malloc(100000);                    // 挡住 c，释放后不会直接退回未切分区域
+        uintptr_t base = addr(a);
+        assert(addr(b) == base + 2 * kSpan && addr(c) == base + 4 * kSpan);
+
+        free(a);
+        free(c);
+        free(b);                                         // 与左右两段合成 6 个 span
+        void* d = malloc(5 * kSpan);                     // 加上头部需要 6 个 span
+        assert(addr(d) == base);
+        free(d);
+
+        void* e = malloc(100000);                        // 从 6 个 span 的段中切出前 2 个
+        void* f = malloc(100000);
+        assert(addr(e) == base && addr(f) == base + 2 * kSpan);
+        free(e);
+        free(f);
+        free(guard);
+    }).join();
+}
+
+// 2. 8KB..32KB 的对象共享 span，不再各占一整个 64KB
+void test_mid_classes() {
+    std::cout << "--- Test 2: Mid Size Classes ---" << std::endl;
+    void* p[4];
+    for (auto& q : p) q = malloc(16000);
+    for (auto& q : p) assert(malloc_usable_size(q) >= 16000 && malloc_usable_size(q) < 32 * 1024);
+    assert(span_of(p[0]) == span_of(p[1]) && span_of(p[1]) == span_of(p[2]) && span_of(p[2]) == span_of(p[3]));
+    for (auto& q : p) free(q);
+
+    void* big = malloc(30000);
+    assert(malloc_usable_size(big) >= 30000 && malloc_usable_size(big) < kSpan / 2);
+    free(big);
+}
+
+// 3. owner 已退出时，其他线程的释放由释放者代为收回；后来的线程接手同一个槽位并复用这块内存
+void test_orphan_frees() {
+    std::cout << "--- Test 3: Orphaned Shard Frees ---" << std::endl;
+    void* p = nullptr;
+    std::thread([&p] { p = malloc(3000); }).join();
+    free(p);
+
+    void* again = nullptr;
+    std::thread([&again] { again = malloc(3000); }).join();
+    assert(addr(again) == addr(p));
+    free(again);
+}
+
+// 4. 槽位随线程退出回收：依次启动的线程远多于 shard 上限，每个仍然拿到自己的 shard
+void test_slot_recycling() {
+    std::cout << "--- Test 4: Shard Slot Recycling ---" << std::endl;
+    for (int i = 0; i < 200; ++i) {
+        std::thread([] {
+            void* volatile p = malloc(64);   // volatile：不让编译器把 malloc/free 成对消掉
+            free(p);
+            assert(memory::stats().mallocs > 0);
+        }).join();
+    }
+}
+
+// 5. 回退到 glibc 的指针（对齐超过一个 span）也能得到正确的可用大小
+void test_libc_usable_size() {
+    std::cout << "--- Test 5: glibc Usable Size ---" << std::endl;
+    void* p = aligned_alloc(128 * 1024, 1000);
+    assert(p && reinterpret_cast<uintptr_t>(p) % (128 * 1024) == 0);
+    // glibc 可能用 mmap 满足这次分配，可用大小取决于对齐点落在映射中的位置，只检查下限并整段写一遍
+    size_t n = malloc_usable_size(p);
+    assert(n >= 1000);
+    std::memset(p, 0x5a, n);
+    p = realloc(p, 5000);
+    assert(malloc_usable_size(p) >= 5000);
+    free(p);
+}
+
+int main() {
+    assert(memory::enabled());
+    test_coalesce();
+    test_mid_classes();
+    test_orphan_frees();
+    test_slot_recycling();
+    test_libc_usable_size();
+    std::cout << "All memory tests passed" << std::endl;
+    return 0;
+}
@@ -1,6 +1,25 @@
 #include "Packet.h"
 #include <iostream>
 #include <cassert>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// 基准：对同一个 Packet 反复 share/slice，与直接使用 shared_ptr<char[]> 的旧实现对比
+template<typename F>
+double ns_per_op(size_t iters, F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iters; ++i) f(i);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iters;
+}
+
+struct SharedPtrPacket {
+    std::shared_ptr<char[]> data;
+    size_t offset = 0;
+    size_t size = 0;
+};
 
 int main() {
     // 1. 创建原始包
@@ -36,6 +55,178 @@ int main() {
     assert(payload.to_string() == "Payload");
     assert((void*)payload.data() == (void*)(full.data() + 8)); // 指针算术验证
 
+    // 4. 所有权：拷贝/移动/析构只改本 shard 的计数
+    std::cout << "\n--- Test 3: Ownership ---" << std::endl;
+    {
+        Packet a = Packet::from_string("ownership");
+        Packet b = a;                       // 拷贝等同 share
+        assert(a.use_count() == 2);
+        Packet c = std::move(b);            // 移动不改计数
+        assert(a.use_count() == 2 && b.size() == 0 && b.data() == nullptr);
+        c = Packet();                       // 赋值释放旧引用
+        assert(a.use_count() == 1);
+
+        Packet s = a.slice(3, 100);         // 截断
+        assert(s.to_string() == "ership" && a.use_count() == 2);
+        assert(a.slice(100, 1).size() == 0);
+
+        // 超过最大 size class 的 buffer 走 operator new
+        Packet big(200000);
+        std::memset(big.data(), 'x', big.size());
+        assert(big.slice(199999, 1).to_string() == "x");
+
+        // 同一 size class 释放后立即被复用
+        const char* addr;
+        {
+            Packet tmp(100);
+            addr = tmp.data();
+        }
+        Packet again(200);
+        assert(again.data() == addr);
+    }
+    std::cout << "Ownership OK" << std::endl;
+
+    // 5. 跨 shard 移交：独占的 buffer 原样移交，被共享的 buffer 先复制
+    std::cout << "\n--- Test 4: ForeignPacket ---" << std::endl;
+    {
+        Packet unique = Packet::from_string("to another shard");
+        const char* unique_addr = unique.data();
+        ForeignPacket moved(std::move(unique));
+
+        Packet kept = Packet::from_string("still shared here");
+        Packet other = kept.share();
+        ForeignPacket copied(std::move(other));
+        assert(kept.use_count() == 1);
+
+        std::thread([&moved, &copied, unique_addr, &kept]() {
+            Packet p = moved.adopt();
+            assert(p.data() == unique_addr);
+            Packet p2 = p.share();          // 在新 shard 上可以正常共享
+            assert(p2.use_count() == 2 && p.to_string() == "to another shard");
+
+            Packet q = copied.adopt();
+            assert(q.data() != kept.data());
+            assert(q.to_string() == "still shared here");
+        }).join();
+
+        // 没有 adopt 的 ForeignPacket 也能安全析构
+        ForeignPacket dropped(Packet::from_string("never adopted"));
+    }
+    std::cout << "ForeignPacket OK" << std::endl;
+
+    // 6. 分散/聚集：拼装不复制，slice 跨越分片，iovec 视图，按需线性化
+    std::cout << "\n--- Test 5: Scatter-Gather ---" << std::endl;
+    {
+        Packet header = Packet::from_string("HTTP/1.1 200 OK\r\n\r\n");
+        Packet body = Packet::from_string("Hello");
+        Packet resp = header.share();
+        resp.append(std::move(body));
+        resp.append(Packet::from_string("!"));
+        resp.prepend(Packet::from_string(">"));
+        assert(resp.nr_frags() == 4 && header.use_count() == 2);
+        assert(resp.to_string() == ">HTTP/1.1 200 OK\r\n\r\nHello!");
+
+        // 跨越 header/body/尾部三个分片
+        Packet mid = resp.slice(resp.size() - 8, 8);
+        assert(mid.nr_frags() == 3 && mid.to_string() == "\r\nHello!");
+
+        struct iovec iov[8];
+        size_t n = resp.to_iovec(iov, 8);
+        assert(n == 4 && iov[2].iov_len == 5 && std::memcmp(iov[2].iov_base, "Hello", 5) == 0);
+
+        // 超出内联容量后扩展到堆上
+        Packet many;
+        for (int i = 0; i < 10; ++i) many.append(Packet::from_string(std::to_string(i)));
+        assert(many.nr_frags() == 10 && many.to_string() == "0123456789");
+        Packet many_copy = many;
+        assert(many_copy.slice(3, 4).to_string() == "3456");
+
+        // data() 需要连续内存时才复制
+        const char* flat = many.data();
+        assert(many.nr_frags() == 1 && std::string(flat, 10) == "0123456789");
+
+        // 同一个 buffer 分两次读到的相邻数据：append 合并成一个分片，data() 不复制
+        Packet recv_buf = Packet::from_string("GET / HTTP/1.1\r\n\r\n");
+        const char* base = recv_buf.data();
+        Packet frame = recv_buf.slice(0, 6);
+        frame.append(recv_buf.slice(6, 8));
+        assert(frame.nr_frags() == 1 && recv_buf.use_count() == 2);
+        assert(frame.data() == base && frame.to_string() == "GET / HTTP/1.1");
+        // 不相邻的不合并
+        frame.append(recv_buf.slice(16, 2));
+        assert(frame.nr_frags() == 2 && frame.to_string() == "GET / HTTP/1.1\r\n");
+    }
+    std::cout << "Scatter-Gather OK" << std::endl;
+
+    // 7. 对象池：分配线程退出之后，别的线程再释放它分配的对象
+    std::cout << "\n--- Test 6: Pool Orphan ---" << std::endl;
+    {
+        struct Obj : Poolable<Obj> { int value; char pad[60]; };
+        std::vector<Obj*> objs;
+        std::thread([&objs]() {
+            for (int i = 0; i < 1000; ++i) {
+                objs.push_back(new Obj());
+                objs.back()->value = i;
+            }
+        }).join();
+
+        // 前一半在分配线程退出之后才推给它（批次在释放线程退出时冲刷），后一半在孤儿池上逐批收回
+        std::thread([&objs]() {
+            for (int i = 0; i < 1000; ++i) {
+                assert(objs[i]->value == i);
+                delete objs[i];
+            }
+        }).join();
+
+        // 之后的线程照常分配、释放
+        std::thread([]() {
+            Obj* o = new Obj();
+            o->value = 7;
+            assert(o->value == 7);
+            delete o;
+        }).join();
+    }
+    std::cout << "Pool Orphan OK" << std::endl;
+
+    // 8. 基准
+    std::cout << "\n--- Bench: share/slice ---" << std::endl;
+    {
+        const size_t iters = 10000000;
+        Packet base = Packet::from_string(std::string(1024, 'a'));
+        SharedPtrPacket old_base{std::shared_ptr<char[]>(new char[1024]), 0, 1024};
+        size_t sink = 0;
+
+        double share_ns = ns_per_op(iters, [&](size_t) {
+            Packet p = base.share();
+            sink += p.size();
+        });
+        double old_share_ns = ns_per_op(iters, [&](size_t) {
+            SharedPtrPacket p = old_base;
+            sink += p.size;
+        });
+        double slice_ns = ns_per_op(iters, [&](size_t i) {
+            Packet p = base.slice(i & 511, 64);
+            sink += p.size();
+        });
+        double old_slice_ns = ns_per_op(iters, [&](size_t i) {
+            SharedPtrPacket p{old_base.data, i & 511, 64};
+            sink += p.size;
+        });
+        double alloc_ns = ns_per_op(iters / 10, [&](size_t) {
+            Packet p(512);
+            sink += p.size();
+        });
+        double old_alloc_ns = ns_per_op(iters / 10, [&](size_t) {
+            SharedPtrPacket p{std::shared_ptr<char[]>(new char[512]), 0, 512};
+            sink += p.size;
+        });
+
+        std::cout << "share:        " << share_ns << " ns/op (shared_ptr: " << old_share_ns << ")" << std::endl;
+        std::cout << "slice:        " << slice_ns << " ns/op (shared_ptr: " << old_slice_ns << ")" << std::endl;
+        std::cout << "Packet(512):  " << alloc_ns << " ns/op (shared_ptr: " << old_alloc_ns << ")" << std::endl;
+        if (sink == 42) std::cout << " ";
+    }
+
     std::cout << "✅ All Zero-Copy tests passed!" << std::endl;
 
     return 0;
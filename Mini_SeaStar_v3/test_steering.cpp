@@ -0,0 +1,183 @@
+// SO_REUSEPORT 分流测试：按序加入、CBPF / eBPF 程序选择与退回哈希分流
+// 编译：g++ -std=c++17 -O2 test_steering.cpp Reactor.cpp -o test_steering -lpthread
+#include "Seastar.h"
+#include "TcpServer.h"
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sched.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+
+using namespace seastar;
+
+constexpr int kOrderPort = 8120;
+constexpr int kCbpfPort = 8121;
+constexpr int kEbpfPort = 8122;
+constexpr int kLatePort = 8123;
+
+Future<void> sleep_ms(int ms) {
+    auto p = make_local<Promise<void>>();
+    auto fut = p->get_future();
+    Reactor::instance()->run_after(ms, [p]() { p->set_value(); });
+    return fut;
+}
+
+// 阻塞式连接到本机端口，三次握手由内核完成，不需要对端先 accept
+int connect_local(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rc = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    assert(rc == 0);
+    return fd;
+}
+
+// 同一端口上 nr 个 shard 的监听 socket，按 shard 0..nr-1 依次 listen；hits[i] 为 shard i accept 的连接数
+struct SteeringGroup {
+    std::vector<std::unique_ptr<TcpServer>> servers;
+    std::shared_ptr<std::vector<int>> hits;
+    std::vector<int> clients;
+
+    SteeringGroup(int port, reuseport::Steering mode, int nr)
+        : hits(std::make_shared<std::vector<int>>(nr, 0)) {
+        for (int i = 0; i < nr; ++i) {
+            auto server = std::make_unique<TcpServer>(Reactor::instance());
+            server->set_steering(mode, i, nr);
+            server->set_connection_handler([hits = hits, i](Socket) { ++(*hits)[i]; });
+            server->listen(port);
+            servers.push_back(std::move(server));
+        }
+    }
+
+    ~SteeringGroup() {
+        for (int fd : clients) ::close(fd);
+    }
+};
+
+// 1. join_in_order：各 shard 以相反的顺序到达，listen 仍按编号依次执行；一轮结束后同一端口可以再来一轮
+void test_join_order() {
+    std::cout << "--- Test 1: join_in_order ---" << std::endl;
+    constexpr int kShards = 4;
+    for (int round = 0; round < 2; ++round) {
+        std::mutex mu;
+        std::vector<int> order;
+        std::vector<int> ordered(kShards, -1);
+        std::vector<std::thread> threads;
+        for (int shard = kShards - 1; shard >= 0; --shard) {
+            threads.emplace_back([&, shard]() {
+                bool ok = reuseport::join_in_order(kOrderPort, shard, kShards, [&]() {
+                    std::lock_guard<std::mutex> lock(mu);
+                    order.push_back(shard);
+                });
+                ordered[shard] = ok ? 1 : 0;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        for (auto& t : threads) t.join();
+        assert(order == std::vector<int>({0, 1, 2, 3}));
+        assert(ordered == std::vector<int>({1, 1, 1, 1}));
+    }
+}
+
+// 2. 前面的 shard listen 失败：异常照常抛给它自己，后面的 shard 不再等待，得到 false（退回哈希分流）
+void test_join_failure() {
+    std::cout << "--- Test 2: join_in_order Failure Fallback ---" << std::endl;
+    bool threw = false;
+    try {
+        reuseport::join_in_order(kOrderPort, 0, 2, []() { throw std::runtime_error("bind failed"); });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    bool listened = false;
+    bool ordered = reuseport::join_in_order(kOrderPort, 1, 2, [&]() { listened = true; });
+    assert(listened && !ordered);
+
+    // 该端口的这一轮已经结束，新一轮重新按序
+    assert(reuseport::join_in_order(kOrderPort, 0, 1, []() {}));
+}
+
+// 3. kIncomingCpu：经典 BPF 按处理 SYN 的 CPU 取模选 shard；本机回环上就是发起连接的这个 CPU
+Future<void> test_incoming_cpu(std::shared_ptr<SteeringGroup> group) {
+    std::cout << "--- Test 3: CBPF Incoming CPU ---" << std::endl;
+    int expected = ::sched_getcpu() % 2;   // Engine 已把本线程钉在一个 CPU 上
+    for (int i = 0; i < 8; ++i) group->clients.push_back(connect_local(kCbpfPort));
+    return sleep_ms(10).then([group, expected]() {
+        assert((*group->hits)[expected] == 8 && (*group->hits)[1 - expected] == 0);
+    });
+}
+
+// 4. kLeastLoaded：eBPF 读取各 shard 发布的连接数，选最少的；没有 BPF 权限时程序选择退回哈希分流
+Future<void> test_least_loaded(std::shared_ptr<SteeringGroup> group) {
+    std::cout << "--- Test 4: eBPF Least Loaded ---" << std::endl;
+    reuseport::LoadTable* table = reuseport::LoadTable::get(2);
+    if (!table) {
+        // 哈希分流下连接照样被某个 shard 接受
+        std::cout << "BPF map unavailable, checking the hash fallback only" << std::endl;
+        group->clients.push_back(connect_local(kEbpfPort));
+        return sleep_ms(10).then([group]() {
+            assert((*group->hits)[0] + (*group->hits)[1] == 1);
+        });
+    }
+
+    table->publish(0, 10);
+    table->publish(1, 3);
+    for (int i = 0; i < 4; ++i) group->clients.push_back(connect_local(kEbpfPort));
+    return sleep_ms(10).then([group, table]() {
+        assert((*group->hits)[0] == 0 && (*group->hits)[1] == 4);
+        table->publish(0, 0);
+        table->publish(1, 0);    // 连接数相同时取编号最小的 shard
+        for (int i = 0; i < 4; ++i) group->clients.push_back(connect_local(kEbpfPort));
+        return sleep_ms(10);
+    }).then([group]() {
+        assert((*group->hits)[0] == 4 && (*group->hits)[1] == 4);
+    });
+}
+
+// 5. 事件循环开始之后才 listen：不进入会阻塞的按序加入，直接退回哈希分流
+Future<void> test_listen_after_start() {
+    std::cout << "--- Test 5: Listen After Reactor Start ---" << std::endl;
+    assert(Reactor::instance()->running());
+    auto server = std::make_shared<TcpServer>(Reactor::instance());
+    auto hits = std::make_shared<int>(0);
+    server->set_steering(reuseport::Steering::kIncomingCpu, 1, 2);   // shard 0 永远不会 listen
+    server->set_connection_handler([hits](Socket) { ++*hits; });
+    auto begin = Clock::now();
+    server->listen(kLatePort);
+    assert(Clock::now() - begin < reuseport::kJoinTimeout / 2);
+    int fd = connect_local(kLatePort);
+    return sleep_ms(10).then([server, hits, fd]() {
+        assert(*hits == 1);
+        ::close(fd);
+    });
+}
+
+int main() {
+    Engine engine;
+    engine.run([&engine] {
+        if (cpu_id() != 0) return;
+        assert(!Reactor::instance()->running());
+        test_join_order();
+        test_join_failure();
+
+        // 按序 listen 只能在事件循环开始之前（user_main 中）完成
+        auto cbpf = std::make_shared<SteeringGroup>(kCbpfPort, reuseport::Steering::kIncomingCpu, 2);
+        auto ebpf = std::make_shared<SteeringGroup>(kEbpfPort, reuseport::Steering::kLeastLoaded, 2);
+
+        test_incoming_cpu(cbpf).then([ebpf]() {
+            return test_least_loaded(ebpf);
+        }).then([]() {
+            return test_listen_after_start();
+        }).then([&engine]() {
+            std::cout << "All steering tests passed" << std::endl;
+            engine.stop();
+        });
+    });
+    return 0;
+}
@@ -0,0 +1,229 @@
+// Semaphore / Gate / ConditionVariable / Reactor 定时器测试
+// 编译：g++ -std=c++17 -O2 test_sync.cpp Reactor.cpp -o test_sync -lpthread
+#include "Seastar.h"
+#include "Semaphore.h"
+#include "Gate.h"
+#include "ConditionVariable.h"
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "UpstreamPool.h"
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace seastar;
+
+constexpr int kPort = 8111;
+
+// 等 ms 毫秒：期间已经排队的 continuation 全部执行完
+Future<void> sleep_ms(int ms) {
+    auto p = make_local<Promise<void>>();
+    auto fut = p->get_future();
+    Reactor::instance()->run_after(ms, [p]() { p->set_value(); });
+    return fut;
+}
+
+// 1. Semaphore：FIFO 唤醒，排在前面的大请求不会被后来的小请求插队
+Future<void> test_semaphore_fifo() {
+    std::cout << "--- Test 1: Semaphore FIFO ---" << std::endl;
+    auto sem = std::make_shared<Semaphore>(2);
+    auto order = std::make_shared<std::vector<int>>();
+
+    sem->wait(1).then([order](bool ok) { assert(ok); order->push_back(1); });
+    sem->wait(2).then([order](bool ok) { assert(ok); order->push_back(2); });
+    sem->wait(1).then([order](bool ok) { assert(ok); order->push_back(3); });
+    assert(sem->available_units() == 1 && sem->waiters() == 2);
+    assert(!sem->try_wait(1));   // 有人排队时 try_wait 也不插队
+
+    return sleep_ms(1).then([sem, order]() {
+        assert(*order == std::vector<int>({1}));
+        sem->signal(1);          // 2 个名额给第二个等待者
+        return sleep_ms(1);
+    }).then([sem, order]() {
+        assert(*order == std::vector<int>({1, 2}));
+        sem->signal(1);
+        return sleep_ms(1);
+    }).then([sem, order]() {
+        assert(*order == std::vector<int>({1, 2, 3}));
+        assert(sem->available_units() == 0 && sem->waiters() == 0);
+    });
+}
+
+// 2. SemaphoreUnits：析构时归还名额
+Future<void> test_semaphore_units() {
+    std::cout << "--- Test 2: Semaphore Units ---" << std::endl;
+    auto sem = std::make_shared<Semaphore>(3);
+    return get_units(*sem, 2).then([sem](SemaphoreUnits units) {
+        assert(units.count() == 2 && sem->available_units() == 1);
+        units.return_units(1);
+        assert(sem->available_units() == 2);
+        SemaphoreUnits moved = std::move(units);
+        assert(units.count() == 0 && moved.count() == 1);
+    }).then([sem]() {
+        assert(sem->available_units() == 3);
+    });
+}
+
+// 3. Semaphore 损坏或销毁：排队者得到 false / 空的 SemaphoreUnits，不会拿到名额
+Future<void> test_semaphore_broken() {
+    std::cout << "--- Test 3: Semaphore Broken ---" << std::endl;
+    auto results = std::make_shared<std::vector<int>>();
+
+    auto sem = std::make_shared<Semaphore>(0);
+    sem->wait().then([results](bool ok) { results->push_back(ok ? 1 : 0); });
+    sem->broken();
+    sem->wait().then([results](bool ok) { results->push_back(ok ? 1 : 0); });
+    assert(sem->is_broken() && sem->waiters() == 0);
+
+    // 信号量随等待者一起销毁：continuation 在之后运行，不能再访问它
+    auto* dying = new Semaphore(0);
+    get_units(*dying, 1).then([results](SemaphoreUnits units) {
+        results->push_back(static_cast<int>(units.count()) + 10);
+    });
+    delete dying;
+
+    return sleep_ms(1).then([results]() {
+        assert(*results == std::vector<int>({0, 0, 10}));
+    });
+}
+
+// 4. Gate：close() 等最后一个 leave()，之后拒绝进入
+Future<void> test_gate() {
+    std::cout << "--- Test 4: Gate ---" << std::endl;
+    auto gate = std::make_shared<Gate>();
+    auto closed = std::make_shared<bool>(false);
+
+    auto holder = std::make_shared<Gate::Holder>(gate->hold());
+    gate->enter();
+    gate->close().then([closed]() { *closed = true; });
+    assert(gate->is_closed() && gate->count() == 2);
+    assert(!gate->try_enter());
+    assert(!gate->try_hold());
+
+    return sleep_ms(1).then([gate, closed, holder]() {
+        assert(!*closed);
+        gate->leave();
+        return sleep_ms(1);
+    }).then([gate, closed, holder]() {
+        assert(!*closed && gate->count() == 1);
+        *holder = Gate::Holder();  // 原来的 Holder 被替换时 leave
+        return sleep_ms(1);
+    }).then([gate, closed]() {
+        assert(*closed && gate->count() == 0);
+    });
+}
+
+// 5. ConditionVariable：带条件的等待在条件满足前继续排队；broken() 以 false 唤醒
+Future<void> test_condition_variable() {
+    std::cout << "--- Test 5: ConditionVariable ---" << std::endl;
+    auto cv = std::make_shared<ConditionVariable>();
+    auto value = std::make_shared<int>(0);
+    auto woken = std::make_shared<std::vector<int>>();
+
+    cv->wait([value]() { return *value >= 2; }).then([woken](bool ok) { assert(ok); woken->push_back(2); });
+    cv->wait().then([woken](bool ok) { assert(ok); woken->push_back(0); });
+    cv->wait().then([woken](bool ok) { assert(ok); woken->push_back(1); });
+
+    *value = 1;
+    cv->signal();                // 第一个等待者条件不满足，放回队尾，唤醒的是第二个
+    return sleep_ms(1).then([cv, value, woken]() {
+        assert(*woken == std::vector<int>({0}));
+        *value = 2;
+        cv->broadcast();         // 队列此时为 [第三个, 第一个]，条件都满足
+        return sleep_ms(1);
+    }).then([cv, woken]() {
+        assert(*woken == std::vector<int>({0, 1, 2}));
+        cv->wait().then([woken](bool ok) { woken->push_back(ok ? 3 : -3); });
+        cv->broken();
+        cv->wait().then([woken](bool ok) { woken->push_back(ok ? 4 : -4); });
+        return sleep_ms(1);
+    }).then([cv, woken]() {
+        // broken() 之后的 wait() 是就绪的 Future，continuation 可能先于被唤醒的排队者执行
+        assert(woken->size() == 5 && (*woken)[3] + (*woken)[4] == -7);
+        assert(!cv->has_waiters());
+    });
+}
+
+// 6. UpstreamPool::stop()：排队中的 acquire() 得到空指针，而不是在停止的池上继续运行
+Future<void> test_upstream_stop() {
+    std::cout << "--- Test 6: UpstreamPool Stop ---" << std::endl;
+    UpstreamOptions options;
+    options.max_connections = 1;
+    auto pool = std::make_shared<UpstreamPool>(Reactor::instance(), "127.0.0.1", kPort, options);
+    auto second = std::make_shared<int>(-1);
+
+    return pool->acquire().then([pool, second](LocalPtr<TcpConnection> conn) {
+        assert(conn);
+        pool->acquire().then([second](LocalPtr<TcpConnection> c) { *second = c ? 1 : 0; });
+        assert(pool->in_use() == 1);
+        pool->stop();
+        pool->release(conn);
+        return sleep_ms(1);
+    }).then([pool, second]() {
+        assert(*second == 0);
+        // 停止之后的 acquire() 立即得到空指针
+        return pool->acquire();
+    }).then([](LocalPtr<TcpConnection> conn) {
+        assert(!conn);
+    });
+}
+
+// 7. Reactor::cancel_timer：取消的定时器不再触发并立即释放捕获的资源；已触发或未知的 id 返回 false
+Future<void> test_cancel_timer() {
+    std::cout << "--- Test 7: Reactor cancel_timer ---" << std::endl;
+    Reactor* r = Reactor::instance();
+    auto fired = std::make_shared<std::vector<int>>();
+    auto captured = std::make_shared<int>(0);
+
+    TimerId a = r->run_after(5, [fired]() { fired->push_back(1); });
+    TimerId b = r->run_after(5, [fired, captured]() { fired->push_back(2); });
+    TimerId c = r->run_after(1, [fired]() { fired->push_back(3); });
+    assert(captured.use_count() == 2);
+    assert(r->cancel_timer(b));
+    assert(captured.use_count() == 1);   // 回调随取消一起销毁
+    assert(!r->cancel_timer(b));
+    assert(!r->cancel_timer(12345678));
+
+    // 大量取消触发堆的重建，剩下的定时器仍然按时触发
+    std::vector<TimerId> many;
+    for (int i = 0; i < 200; ++i) many.push_back(r->run_after(3, [fired]() { fired->push_back(-1); }));
+    for (TimerId id : many) assert(r->cancel_timer(id));
+
+    return sleep_ms(20).then([r, fired, a, c]() {
+        assert(*fired == std::vector<int>({3, 1}));
+        assert(!r->cancel_timer(a) && !r->cancel_timer(c));
+    });
+}
+
+int main() {
+    Engine engine;
+    engine.run([&engine] {
+        if (cpu_id() != 0) return;
+        static thread_local std::unique_ptr<TcpServer> server;
+        Reactor* r = Reactor::instance();
+        server = std::make_unique<TcpServer>(r);
+        server->set_connection_handler([r](Socket sock) {
+            TcpConnection::create(std::move(sock), r);
+        });
+        server->listen(kPort);
+
+        test_semaphore_fifo().then([]() {
+            return test_semaphore_units();
+        }).then([]() {
+            return test_semaphore_broken();
+        }).then([]() {
+            return test_gate();
+        }).then([]() {
+            return test_condition_variable();
+        }).then([]() {
+            return test_upstream_stop();
+        }).then([]() {
+            return test_cancel_timer();
+        }).then([&engine]() {
+            std::cout << "All sync tests passed" << std::endl;
+            engine.stop();
+        });
+    });
+    return 0;
+}
@@ -0,0 +1,654 @@
+// TcpConnection 回环测试
+// 编译：g++ -std=c++17 -O2 test_tcp.cpp Reactor.cpp -o test_tcp -lpthread
+#include "Seastar.h"
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "InputStream.h"
+#include "UpstreamPool.h"
+#include "FutureUtil.h"
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace seastar;
+
+const std::string kEchoPath = "@test_tcp.echo";
+const std::string kBacklogPath = "@test_tcp.backlog";
+const std::string kSinkPath = "@test_tcp.sink";
+
+// sink 服务端 accept 出来的连接：不自动读取，由测试决定何时读
+static thread_local std::deque<LocalPtr<TcpConnection>> g_accepted;
+
+// 等 ms 毫秒：期间已经排队的 continuation 全部执行完
+Future<void> sleep_ms(int ms) {
+    auto p = make_local<Promise<void>>();
+    auto fut = p->get_future();
+    Reactor::instance()->run_after(ms, [p]() { p->set_value(); });
+    return fut;
+}
+
+void echo(LocalPtr<TcpConnection> conn) {
+    repeat([conn]() {
+        return conn->read().then([conn](Packet p) {
+            if (p.size() == 0) return Future<StopIteration>::make_ready(StopIteration::yes);
+            return conn->write(std::move(p)).then([](ssize_t n) {
+                return n < 0 ? StopIteration::yes : StopIteration::no;
+            });
+        });
+    });
+}
+
+// 写出 msg，读回同样长度的回显
+Future<std::string> round_trip(LocalPtr<TcpConnection> conn, const std::string& msg) {
+    auto in = make_local<InputStream>(conn);
+    conn->write(Packet::from_string(msg));
+    return in->read_exactly(msg.size()).then([in](Packet p) {
+        return p.to_string();
+    });
+}
+
+// 连上 sink 服务，得到 (客户端, 服务端) 两端
+using ConnPair = std::pair<LocalPtr<TcpConnection>, LocalPtr<TcpConnection>>;
+Future<ConnPair> connect_sink() {
+    return TcpConnection::connect_unix(Reactor::instance(), kSinkPath).then([](LocalPtr<TcpConnection> conn) {
+        assert(conn);
+        return sleep_ms(5).then([conn]() {
+            assert(!g_accepted.empty());
+            auto server = g_accepted.front();
+            g_accepted.pop_front();
+            return ConnPair(conn, server);
+        });
+    });
+}
+
+std::string pattern(size_t n, char seed) {
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; ++i) s[i] = static_cast<char>(seed + i % 251);
+    return s;
+}
+
+// n 个分片、每片 frag 字节的 Packet，每个分片各占一个 buffer；内容依次追加到 expected
+Packet fragmented(size_t n, size_t frag, char seed, std::string* expected) {
+    Packet p;
+    for (size_t i = 0; i < n; ++i) {
+        std::string s = pattern(frag, static_cast<char>(seed + i));
+        expected->append(s);
+        p.append(Packet::from_string(s));
+    }
+    return p;
+}
+
+// 1. connect_unix：连上回显服务并往返一次；路径不存在时得到空指针
+Future<void> test_connect_unix() {
+    std::cout << "--- Test 1: connect_unix ---" << std::endl;
+    Reactor* r = Reactor::instance();
+    return TcpConnection::connect_unix(r, kEchoPath).then([](LocalPtr<TcpConnection> conn) {
+        assert(conn && !conn->is_closed());
+        return round_trip(conn, "hello unix").then([conn](std::string got) {
+            assert(got == "hello unix");
+            conn->close();
+        });
+    }).then([r]() {
+        return TcpConnection::connect_unix(r, "@test_tcp.missing");
+    }).then([](LocalPtr<TcpConnection> conn) {
+        assert(!conn);
+    });
+}
+
+// 2. 对端 backlog 已满：connect_unix 按间隔重试，对端 accept 之后完成；一直不 accept 则超时
+Future<void> test_connect_unix_backlog() {
+    std::cout << "--- Test 2: connect_unix Backlog Full ---" << std::endl;
+    Reactor* r = Reactor::instance();
+    auto listener = std::make_shared<Socket>(Socket::create_unix());
+    listener->bind_unix(kBacklogPath);
+    assert(::listen(listener->fd(), 0) == 0);   // backlog 0：只容纳一个未 accept 的连接
+
+    auto first = std::make_shared<LocalPtr<TcpConnection>>();
+    return TcpConnection::connect_unix(r, kBacklogPath).then([r, first](LocalPtr<TcpConnection> conn) {
+        assert(conn);
+        *first = conn;
+        // 队列已满，第二个连接进入重试；没人 accept 时在超时后得到空指针
+        return TcpConnection::connect_unix(r, kBacklogPath, 20);
+    }).then([r, listener](LocalPtr<TcpConnection> conn) {
+        assert(!conn);
+        // 30ms 后 accept 掉排队的连接，腾出位置，重试中的连接随之完成
+        r->run_after(30, [listener]() { listener->accept(); });
+        return TcpConnection::connect_unix(r, kBacklogPath, 1000);
+    }).then([first, listener](LocalPtr<TcpConnection> conn) {
+        assert(conn && !conn->is_closed());
+        conn->close();
+        (*first)->close();
+    });
+}
+
+// 3. UpstreamPool 接受 Unix 域 socket 上游：建连、往返，归还后复用同一条连接
+Future<void> test_upstream_unix() {
+    std::cout << "--- Test 3: UpstreamPool over Unix Socket ---" << std::endl;
+    auto pool = std::make_shared<UpstreamPool>(Reactor::instance(), UnixEndpoint{kEchoPath});
+    return pool->acquire().then([pool](LocalPtr<TcpConnection> conn) {
+        assert(conn);
+        return round_trip(conn, "via pool").then([pool, conn](std::string got) {
+            assert(got == "via pool");
+            pool->release(conn);
+            return pool->acquire();
+        });
+    }).then([pool](LocalPtr<TcpConnection> conn) {
+        assert(conn && pool->stats().connects == 1 && pool->stats().reused == 1);
+        pool->release(conn);
+        pool->stop();
+    });
+}
+
+// 4. read(deadline)：超时得到 nullopt，之后到达的数据照常由下一次 read() 取走
+Future<void> test_read_deadline() {
+    std::cout << "--- Test 4: Read Deadline ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto begin = Clock::now();
+        return server->read(begin + std::chrono::milliseconds(20)).then([client, server, begin](std::optional<Packet> p) {
+            assert(!p && Clock::now() - begin >= std::chrono::milliseconds(20));
+            assert(!server->is_closed());
+            client->write(Packet::from_string("late"));
+            return server->read(Clock::now() + std::chrono::milliseconds(1000));
+        }).then([client, server](std::optional<Packet> p) {
+            assert(p && p->to_string() == "late");
+            client->close();
+            server->close();
+        });
+    });
+}
+
+// 5. write(deadline)：超时只取消这一次写入
+//    大写入 A 填满发送缓冲区后排队，B 排在它后面、一个字节都没发出，超时后被摘除；
+//    对端读完时收到的恰好是 A 和之后的 C，A 和 C 都正常完成
+Future<void> test_write_deadline() {
+    std::cout << "--- Test 5: Write Deadline Cancels One Entry ---" << std::endl;
+    constexpr size_t kBig = 4 << 20;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto a_result = std::make_shared<ssize_t>(0);
+        auto c_result = std::make_shared<ssize_t>(0);
+        std::string a = pattern(kBig, 'a');
+        client->write(Packet::from_string(a)).then([a_result](ssize_t n) { *a_result = n; });
+        return client->write(Packet::from_string("BBBB"), Clock::now() + std::chrono::milliseconds(20))
+            .then([client, server, a_result, c_result](std::optional<ssize_t> b) {
+                assert(!b && !client->is_closed() && *a_result == 0);
+                client->write(Packet::from_string("CCCC")).then([c_result](ssize_t n) { *c_result = n; });
+                auto in = make_local<InputStream>(server);
+                return in->read_exactly(kBig + 4).then([in, client, server](Packet p) {
+                    assert(p.size() == kBig + 4);
+                    assert(p.to_string() == pattern(kBig, 'a') + "CCCC");
+                    client->close();
+                    return sleep_ms(1);
+                });
+            }).then([server, a_result, c_result]() {
+                assert(*a_result == static_cast<ssize_t>(kBig) && *c_result == 4);
+                server->close();
+            });
+    });
+}
+
+// 6. 已经部分发出的写入超时：剩余部分既不能撤回也不能跳过，连接被关闭
+Future<void> test_write_deadline_partial() {
+    std::cout << "--- Test 6: Write Deadline on Partial Write ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        return client->write(Packet::from_string(pattern(4 << 20, 'x')), Clock::now() + std::chrono::milliseconds(20))
+            .then([client, server](std::optional<ssize_t> n) {
+                assert(!n && client->is_closed());
+                server->close();
+            });
+    });
+}
+
+// 7. Unix 域 socket 的对端写完立即关闭：EPOLLHUP 与数据同时到达，数据仍然交给 read()
+Future<void> test_unix_peer_close() {
+    std::cout << "--- Test 7: Unix Peer Close After Write ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        client->write(Packet::from_string("last words")).then([client](ssize_t) { client->close(); });
+        return sleep_ms(5).then([server]() {
+            assert(!server->is_closed() && server->buffered_bytes() == 10);
+            return server->read();
+        }).then([server](Packet p) {
+            assert(p.to_string() == "last words");
+            return server->read();
+        }).then([server](Packet p) {
+            assert(p.size() == 0 && server->is_closed());
+        });
+    });
+}
+
+// 8. InputStream::read_exactly 跨两个 NetBuffer
+//    一次写入 3000 字节：服务端第一个接收 buffer 是 1024 字节，其余进第二个 buffer，
+//    第二帧 [1000, 2000) 跨过两个 buffer 的边界，交出时拷贝成一块连续内存
+Future<void> test_read_exactly_across_buffers() {
+    std::cout << "--- Test 8: read_exactly Across NetBuffers ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto in = make_local<InputStream>(server);
+        auto sent = std::make_shared<std::string>(pattern(3000, 'r'));
+        client->write(Packet::from_string(*sent));
+        return in->read_exactly(1000).then([in, sent](Packet p) {
+            assert(p.to_string() == sent->substr(0, 1000));
+            return in->read_exactly(1000);
+        }).then([in, sent](Packet p) {
+            assert(p.nr_frags() == 1 && p.to_string() == sent->substr(1000, 1000));
+            return in->read_exactly(1000);
+        }).then([in, sent, client, server](Packet p) {
+            assert(p.to_string() == sent->substr(2000, 1000));
+            assert(in->buffered() == 0);
+            client->close();
+            server->close();
+        });
+    });
+}
+
+// 9. read_exactly 在 EOF 前只剩不足 n 字节：返回剩下的全部，之后返回空 Packet
+Future<void> test_read_exactly_eof() {
+    std::cout << "--- Test 9: read_exactly at EOF ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto in = make_local<InputStream>(server);
+        client->write(Packet::from_string("0123456789")).then([client](ssize_t) { client->close(); });
+        return in->read_exactly(100).then([in](Packet p) {
+            assert(p.to_string() == "0123456789" && in->eof());
+            return in->read_exactly(5);
+        }).then([server](Packet p) {
+            assert(p.size() == 0);
+            server->close();
+        });
+    });
+}
+
+// 10. read_until：分隔符被两个接收 buffer 切开（matches_at 跨分片确认）
+//    1022 字节之后紧跟 "\r\n\r\n"，分隔符的前两个字节落在第一个 1024 字节的 buffer 末尾
+Future<void> test_read_until_split_delimiter() {
+    std::cout << "--- Test 10: read_until Split Delimiter ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto in = make_local<InputStream>(server);
+        client->write(Packet::from_string(std::string(1022, 'h') + "\r\n\r\ntail"));
+        return in->read_until("\r\n\r\n").then([in](Packet p) {
+            assert(p.to_string() == std::string(1022, 'h'));
+            return in->read_exactly(4);
+        }).then([client, server](Packet p) {
+            assert(p.to_string() == "tail");
+            client->close();
+            server->close();
+        });
+    });
+}
+
+// 11. read_until 的续扫：分隔符的前缀在上一批数据末尾，剩余部分随下一批到达；
+//     续扫从可能构成前缀的位置开始，既不漏掉这个分隔符，也不把已确认的部分当成分隔符
+Future<void> test_read_until_resume() {
+    std::cout << "--- Test 11: read_until Resume Scan ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto in = make_local<InputStream>(server);
+        client->write(Packet::from_string("GET / HTTP/1.1\r\nA: b\r\n\r"));
+        Reactor::instance()->run_after(10, [client]() {
+            client->write(Packet::from_string("\nbody\r\n")).then([client](ssize_t) { client->close(); });
+        });
+        return in->read_until("\r\n\r\n").then([in](Packet p) {
+            assert(p.to_string() == "GET / HTTP/1.1\r\nA: b");
+            // 剩下的 "body\r\n" 末尾只是分隔符的前缀，到 EOF 都找不到分隔符，返回剩余的全部数据
+            return in->read_until("\r\n\r\n");
+        }).then([in, server](Packet p) {
+            assert(p.to_string() == "body\r\n" && in->eof());
+            server->close();
+        });
+    });
+}
+
+// 12. consume：消费者停在帧中间，把没用完的字节还给流，之后的读取从这些字节开始
+Future<void> test_consume_unconsumed() {
+    std::cout << "--- Test 12: consume Returns Unconsumed Bytes ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto in = make_local<InputStream>(server);
+        auto header = std::make_shared<std::string>();
+        client->write(Packet::from_string("len=12|hello"));
+        Reactor::instance()->run_after(10, [client]() {
+            client->write(Packet::from_string(", world")).then([client](ssize_t) { client->close(); });
+        });
+        // 逐块累积到 '|' 为止；'|' 之后的 "hello" 还回流中，与之后到达的部分拼成完整的 body
+        return in->consume([header](Packet data) {
+            assert(data.size() > 0);
+            std::string chunk = data.to_string();
+            size_t bar = chunk.find('|');
+            if (bar == std::string::npos) {
+                *header += chunk;
+                return ConsumeResult::more();
+            }
+            *header += chunk.substr(0, bar);
+            return ConsumeResult::done(data.drop_front(bar + 1));
+        }).then([in, header]() {
+            assert(*header == "len=12");
+            return in->read_exactly(12);
+        }).then([in](Packet p) {
+            assert(p.to_string() == "hello, world");
+            // 再次 consume：EOF 时收到一个空 Packet，循环随之结束
+            auto calls = std::make_shared<int>(0);
+            return in->consume([calls](Packet data) {
+                ++*calls;
+                assert(data.size() == 0);
+                return ConsumeResult::more();
+            }).then([calls]() {
+                assert(*calls == 1);
+            });
+        }).then([server]() {
+            server->close();
+        });
+    });
+}
+
+// 13. send_file：输出流模式下空闲连接的第一次发送立即发出；之后排队的文件字节计入输出水位和 shard 预算，
+//     与前后的 write() 按调用顺序到达对端，发完后全部归还
+Future<void> test_send_file() {
+    std::cout << "--- Test 13: send_file ---" << std::endl;
+    constexpr size_t kFile = 4 << 20;
+    char path[] = "/tmp/test_tcp.sendfile.XXXXXX";
+    int fd = ::mkstemp(path);
+    assert(fd >= 0);
+    ::unlink(path);
+    std::string content = pattern(kFile, 'f');
+    assert(::write(fd, content.data(), content.size()) == static_cast<ssize_t>(kFile));
+
+    size_t budget = ShardBufferBudget::local().used();
+    return connect_sink().then([fd, budget](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto results = std::make_shared<std::vector<ssize_t>>();
+        client->set_batch_writes(true);
+
+        client->send_file(fd, 0, 1000).then([results](ssize_t n) { results->push_back(n); });
+        assert(client->queued_output_bytes() == 0);   // 空闲连接：不等迭代结束，已经交给内核
+
+        client->write(Packet::from_string("HDR"));
+        client->send_file(fd, 0, kFile).then([results](ssize_t n) { results->push_back(n); });
+        client->write(Packet::from_string("TAIL"));
+        assert(client->queued_output_bytes() == 3 + kFile + 4);
+        assert(ShardBufferBudget::local().used() >= budget + kFile);
+        assert(!client->writable());                  // 文件字节超过 output_high
+
+        auto in = make_local<InputStream>(server);
+        return in->read_exactly(1000 + 3 + kFile + 4).then([in, client, server, results, fd](Packet p) {
+            std::string expect = pattern(kFile, 'f');
+            assert(p.to_string() == expect.substr(0, 1000) + "HDR" + expect + "TAIL");
+            assert(client->queued_output_bytes() == 0 && client->writable());
+            assert(*results == std::vector<ssize_t>({1000, static_cast<ssize_t>(kFile)}));
+            ::close(fd);
+            client->close();
+            server->close();
+        });
+    }).then([]() {
+        return sleep_ms(1);
+    }).then([budget]() {
+        // 两端连接和读到的 Packet 都已释放
+        assert(ShardBufferBudget::local().used() == budget);
+    });
+}
+
+// 14. 零拷贝交出的 Packet 钉住接收 buffer：读入的字节在 read() 之后仍计入 shard 预算，
+//     连接销毁后也一样，直到最后一个引用它的 Packet 释放才归还
+Future<void> test_budget_pinned_by_packets() {
+    std::cout << "--- Test 14: Budget Held by Zero-Copy Packets ---" << std::endl;
+    size_t budget = ShardBufferBudget::local().used();
+    auto held = std::make_shared<Packet>();
+    return connect_sink().then([budget, held](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        client->write(Packet::from_string(pattern(1000, 'z')));
+        return sleep_ms(5).then([server]() {
+            return server->read();
+        }).then([client, server, budget, held](Packet p) {
+            assert(p.size() == 1000 && p.nr_frags() == 1 && server->buffered_bytes() == 0);
+            assert(ShardBufferBudget::local().used() == budget + 1000);
+            *held = std::move(p);
+            client->close();
+            server->close();
+        });
+    }).then([]() {
+        return sleep_ms(1);
+    }).then([budget, held]() {
+        // 连接已经销毁，Packet 仍然引用着它读入的 buffer
+        assert(ShardBufferBudget::local().used() == budget + 1000);
+        assert(held->to_string() == pattern(1000, 'z'));
+        *held = Packet();
+        assert(ShardBufferBudget::local().used() == budget);
+    });
+}
+
+// 15. 一次写入的分片数超过 IOV_MAX：立即发送和排队续传都按 IOV_MAX 分批交给 sendmsg，字节顺序不变
+Future<void> test_write_many_fragments() {
+    std::cout << "--- Test 15: Write More Than IOV_MAX Fragments ---" << std::endl;
+    constexpr size_t kFrags = IOV_MAX * 2 + 100;
+    constexpr size_t kFragSize = 10;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto expected = std::make_shared<std::string>();
+
+        // 空闲连接：write() 当场分几次 sendmsg 发完
+        Packet p = fragmented(kFrags, kFragSize, 'f', expected.get());
+        assert(p.nr_frags() == kFrags);
+        auto fut = client->write(std::move(p));
+        assert(fut.available() && fut.get() == static_cast<ssize_t>(kFrags * kFragSize));
+
+        // 大块数据占满发送缓冲区后，分片多的 Packet 排队，由 flush_output 分批续传
+        std::string big = pattern(4 << 20, 'b');
+        expected->append(big);
+        client->write(Packet::from_string(big));
+        auto result = std::make_shared<ssize_t>(0);
+        client->write(fragmented(kFrags, kFragSize, 'q', expected.get())).then([result](ssize_t n) {
+            *result = n;
+        });
+        assert(client->queued_output_bytes() > kFrags * kFragSize);
+
+        auto in = make_local<InputStream>(server);
+        return in->read_exactly(expected->size()).then([in, expected](Packet got) {
+            assert(got.to_string() == *expected);
+            return sleep_ms(1);
+        }).then([client, server, result]() {
+            assert(*result == static_cast<ssize_t>(kFrags * kFragSize));
+            client->close();
+            server->close();
+        });
+    });
+}
+
+// 16. 发送缓冲区只收下一个条目的一部分：剩余部分从分片中间续传，排在后面的写入随后完成
+Future<void> test_partial_write_resume() {
+    std::cout << "--- Test 16: Partial Write Resumes Mid-Entry ---" << std::endl;
+    constexpr size_t kFrags = 70;
+    constexpr size_t kFragSize = 60000;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto expected = std::make_shared<std::string>();
+        auto order = std::make_shared<std::vector<int>>();
+
+        client->write(fragmented(kFrags, kFragSize, 'p', expected.get())).then([order](ssize_t n) {
+            assert(n == static_cast<ssize_t>(kFrags * kFragSize));
+            order->push_back(1);
+        });
+        // 已经发出了一部分，其余留在队列里
+        size_t queued = client->queued_output_bytes();
+        assert(queued > 0 && queued < kFrags * kFragSize);
+
+        client->write(fragmented(3, 100, 's', expected.get())).then([order](ssize_t n) {
+            assert(n == 300);
+            order->push_back(2);
+        });
+        assert(client->queued_output_bytes() == queued + 300);
+
+        auto in = make_local<InputStream>(server);
+        return in->read_exactly(expected->size()).then([in, expected](Packet got) {
+            assert(got.to_string() == *expected);
+            return sleep_ms(1);
+        }).then([client, server, order]() {
+            assert(*order == std::vector<int>({1, 2}));
+            assert(client->queued_output_bytes() == 0);
+            client->close();
+            server->close();
+        });
+    });
+}
+
+// 17. 输出流模式：同一轮里只有第一次写入立即发出，其余排队，本轮迭代结束时合并发送；下一轮重新开始
+Future<void> test_batch_writes() {
+    std::cout << "--- Test 17: Batch Writes Coalesce per Iteration ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        auto expected = std::make_shared<std::string>();
+        auto done = std::make_shared<int>(0);
+        client->set_batch_writes(true);
+
+        for (int i = 0; i < 10; ++i) {
+            std::string msg = pattern(100, static_cast<char>('a' + i));
+            expected->append(msg);
+            client->write(Packet::from_string(msg)).then([done](ssize_t n) {
+                assert(n == 100);
+                ++*done;
+            });
+        }
+        assert(*done == 1 && client->queued_output_bytes() == 900);
+
+        auto in = make_local<InputStream>(server);
+        return sleep_ms(5).then([client, server, done]() {
+            assert(*done == 10 && client->queued_output_bytes() == 0);
+            assert(server->buffered_bytes() == 1000);
+
+            // 新的一轮：第一次写入又立即发出
+            auto fut = client->write(Packet::from_string("next"));
+            assert(fut.available() && client->queued_output_bytes() == 0);
+
+            // 关闭输出流模式后每次写入都立即发出
+            client->set_batch_writes(false);
+            for (int i = 0; i < 3; ++i) {
+                assert(client->write(Packet::from_string("x")).available());
+            }
+            assert(client->queued_output_bytes() == 0);
+        }).then([in, expected]() {
+            return in->read_exactly(expected->size() + 7);
+        }).then([in, expected, client, server](Packet got) {
+            assert(got.to_string() == *expected + "nextxxx");
+            client->close();
+            server->close();
+        });
+    });
+}
+
+// 客户端写 size 字节、服务端一次读完，重复 rounds 轮：服务端每轮读到的就是 size 字节
+Future<void> exchange_rounds(LocalPtr<TcpConnection> client, LocalPtr<TcpConnection> server, size_t size, int rounds) {
+    auto left = std::make_shared<int>(rounds);
+    return repeat([client, server, size, left]() {
+        client->write(Packet::from_string(pattern(size, 'h')));
+        return sleep_ms(2).then([server]() {
+            return server->read();
+        }).then([size, left](Packet p) {
+            assert(p.size() == size);
+            return --*left == 0 ? StopIteration::yes : StopIteration::no;
+        });
+    });
+}
+
+// 18. 接收 buffer 的选级依据跟随每轮读到的字节数：持续的大块流量把它推高，之后的小请求让它回落
+Future<void> test_read_size_hint() {
+    std::cout << "--- Test 18: Adaptive Read Size ---" << std::endl;
+    return connect_sink().then([](ConnPair pair) {
+        auto client = pair.first;
+        auto server = pair.second;
+        assert(server->read_size_hint() == NetBuffer::kClassSizes[0]);
+
+        return exchange_rounds(client, server, 32 * 1024, 12).then([client, server]() {
+            size_t hint = server->read_size_hint();
+            assert(hint > NetBuffer::kClassSizes[2] && hint <= 32 * 1024);
+            return exchange_rounds(client, server, 100, 12);
+        }).then([client, server]() {
+            assert(server->read_size_hint() < NetBuffer::kClassSizes[1]);
+            client->close();
+            server->close();
+        });
+    });
+}
+
+int main() {
+    Engine engine;
+    engine.run([&engine] {
+        if (cpu_id() != 0) return;
+        static thread_local std::unique_ptr<TcpServer> uds;
+        Reactor* r = Reactor::instance();
+        uds = std::make_unique<TcpServer>(r);
+        uds->set_connection_handler([r](Socket sock) {
+            echo(TcpConnection::create(std::move(sock), r));
+        });
+        uds->listen_unix(kEchoPath);
+
+        static thread_local std::unique_ptr<TcpServer> sink;
+        sink = std::make_unique<TcpServer>(r);
+        sink->set_connection_handler([r](Socket sock) {
+            g_accepted.push_back(TcpConnection::create(std::move(sock), r));
+        });
+        sink->listen_unix(kSinkPath);
+
+        test_connect_unix().then([]() {
+            return test_connect_unix_backlog();
+        }).then([]() {
+            return test_upstream_unix();
+        }).then([]() {
+            return test_read_deadline();
+        }).then([]() {
+            return test_write_deadline();
+        }).then([]() {
+            return test_write_deadline_partial();
+        }).then([]() {
+            return test_unix_peer_close();
+        }).then([]() {
+            return test_read_exactly_across_buffers();
+        }).then([]() {
+            return test_read_exactly_eof();
+        }).then([]() {
+            return test_read_until_split_delimiter();
+        }).then([]() {
+            return test_read_until_resume();
+        }).then([]() {
+            return test_consume_unconsumed();
+        }).then([]() {
+            return test_send_file();
+        }).then([]() {
+            return test_budget_pinned_by_packets();
+        }).then([]() {
+            return test_write_many_fragments();
+        }).then([]() {
+            return test_partial_write_resume();
+        }).then([]() {
+            return test_batch_writes();
+        }).then([]() {
+            return test_read_size_hint();
+        }).then([&engine]() {
+            std::cout << "All TCP tests passed" << std::endl;
+            engine.stop();
+        });
+    });
+    return 0;
+}
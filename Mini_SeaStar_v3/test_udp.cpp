@@ -0,0 +1,135 @@
+// UdpChannel 回环测试
+// 编译：g++ -std=c++17 -O2 test_udp.cpp Reactor.cpp -o test_udp -lpthread
+#include "Seastar.h"
+#include "UdpChannel.h"
+#include "FutureUtil.h"
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace seastar;
+
+constexpr int kPort = 8110;
+constexpr int kBatches = 16;
+constexpr int kPerBatch = 64;       // 每批发完等全部收到再发下一批，不超出内核接收缓冲区
+
+// 报文内容：4 字节序号 + 由序号决定的填充，长度 8..1407 不等
+std::string make_payload(uint32_t seq) {
+    std::string s(8 + (seq * 37) % 1400, '\0');
+    std::memcpy(&s[0], &seq, sizeof(seq));
+    for (size_t i = sizeof(seq); i < s.size(); ++i) s[i] = static_cast<char>(seq + i);
+    return s;
+}
+
+struct LoopbackState {
+    LocalPtr<UdpChannel> server;
+    LocalPtr<UdpChannel> client;
+    sockaddr_in to{};
+    uint32_t next_seq = 0;      // 期望收到的下一个序号
+    int gso_received = 0;
+};
+
+void send_batch(LoopbackState& st, int batch) {
+    for (int i = 0; i < kPerBatch; ++i) {
+        st.client->send(st.to, Packet::from_string(make_payload(batch * kPerBatch + i)));
+    }
+}
+
+// 1. 分批发送，检查每个报文按顺序到达且内容完整
+Future<void> test_order(std::shared_ptr<LoopbackState> st) {
+    std::cout << "--- Test 1: Loopback Order ---" << std::endl;
+    send_batch(*st, 0);
+    return repeat([st]() {
+        return st->server->receive().then([st](Datagram d) {
+            std::string got = d.data.to_string();
+            assert(got == make_payload(st->next_seq));
+            // 小报文复制到刚好大小的 buffer，不钉住整个接收 buffer
+            if (got.size() * 4 <= UdpOptions().max_datagram) {
+                assert(d.data.nr_frags() == 1 && d.data.fragment(0).buf->capacity <= 1024);
+            }
+            ++st->next_seq;
+            if (st->next_seq == kBatches * kPerBatch) return StopIteration::yes;
+            if (st->next_seq % kPerBatch == 0) send_batch(*st, static_cast<int>(st->next_seq / kPerBatch));
+            return StopIteration::no;
+        });
+    }).then([st]() {
+        std::cout << "received " << st->next_seq << " datagrams in order, "
+                  << st->server->stats().rx_syscalls << " recvmmsg calls" << std::endl;
+    });
+}
+
+// 2. GSO：一次发送按段长切成多个报文，依次到达
+Future<void> test_gso(std::shared_ptr<LoopbackState> st) {
+    std::cout << "--- Test 2: GSO Segments ---" << std::endl;
+    std::string big;
+    for (int k = 0; k < 10; ++k) big += std::string(1000, static_cast<char>('A' + k));
+    st->client->send(st->to, Packet::from_string(big), 1000);
+    return repeat([st]() {
+        return st->server->receive().then([st](Datagram d) {
+            assert(d.data.to_string() == std::string(1000, static_cast<char>('A' + st->gso_received)));
+            return ++st->gso_received == 10 ? StopIteration::yes : StopIteration::no;
+        });
+    }).then([st]() {
+        std::cout << "received " << st->gso_received << " segments" << std::endl;
+    });
+}
+
+// 3. 同时挂起多个 receive()：报文按调用顺序交付，关闭时剩下的等待者得到空报文
+Future<void> test_concurrent_receive(std::shared_ptr<LoopbackState> st) {
+    std::cout << "--- Test 3: Concurrent Receivers ---" << std::endl;
+    auto got = std::make_shared<std::vector<std::string>>(4);
+    auto waits = std::make_shared<std::vector<Future<void>>>();
+    for (int i = 0; i < 4; ++i) {
+        waits->push_back(st->server->receive().then([got, i](Datagram d) {
+            (*got)[i] = d.data.to_string();
+        }));
+    }
+    for (const char* msg : {"first", "second", "third"}) {
+        st->client->send(st->to, Packet::from_string(msg));
+    }
+    return std::move((*waits)[2]).then([st, got, waits]() {
+        assert((*got)[0] == "first" && (*got)[1] == "second" && (*got)[2] == "third");
+        // 第四个等待者一直等不到报文，由 close() 以空报文唤醒
+        st->server->close();
+        return std::move((*waits)[3]);
+    }).then([got]() {
+        assert((*got)[3].empty());
+    });
+}
+
+// 4. 报文全部取走、通道关闭后，接收队列计入 shard 预算的字节全部归还，发送端没有丢包
+Future<void> test_budget_released(std::shared_ptr<LoopbackState> st) {
+    std::cout << "--- Test 4: Budget Released ---" << std::endl;
+    assert(ShardBufferBudget::local().used() == 0);
+    assert(st->client->stats().tx_dropped == 0);
+    st->client->close();
+    return Future<void>::make_ready();
+}
+
+int main() {
+    Engine engine;
+    engine.run([&engine] {
+        if (cpu_id() != 0) return;
+        Reactor* r = Reactor::instance();
+        auto st = std::make_shared<LoopbackState>();
+        st->server = UdpChannel::bind(r, kPort);
+        st->client = UdpChannel::bind(r, 0);
+        st->to.sin_family = AF_INET;
+        st->to.sin_port = htons(kPort);
+        st->to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        test_order(st).then([st]() {
+            return test_gso(st);
+        }).then([st]() {
+            return test_concurrent_receive(st);
+        }).then([st]() {
+            return test_budget_released(st);
+        }).then([&engine]() {
+            std::cout << "All UDP tests passed" << std::endl;
+            engine.stop();
+        });
+    });
+    return 0;
+}